@@ -0,0 +1,138 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiBenchmark.h"
+#include "GD.h"
+#include "KodiInterface.h"
+
+#include <sys/resource.h>
+#include <thread>
+
+namespace Kodi
+{
+
+namespace
+{
+int64_t getCpuTime()
+{
+	struct rusage usage{};
+	if(getrusage(RUSAGE_SELF, &usage) == -1) return 0;
+	return (int64_t)(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000 + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+}
+
+BaseLib::PVariable KodiBenchmark::run(const std::string& hostname, int32_t port, int64_t duration, int32_t requestRate)
+{
+	try
+	{
+		//Shared with the callbacks, which might be called after this method returned.
+		struct State
+		{
+			std::atomic<uint64_t> notifications{0};
+			std::atomic<uint64_t> responses{0};
+			KodiHistogram roundTripTimes{65536};
+		};
+		auto state = std::make_shared<State>();
+
+		auto interface = std::make_shared<KodiInterface>();
+		std::string interfaceHostname = hostname;
+		interface->setHostname(interfaceHostname);
+		interface->setPort(port);
+		KodiInterface::Subscriber subscriber;
+		subscriber.packetReceived = [state](KodiPacket& packet) { state->notifications++; };
+		interface->subscribe(subscriber);
+		interface->startListening();
+
+		for(int32_t i = 0; i < 500 && interface->getConnectionState() != KodiInterface::ConnectionState::connected; i++)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+		if(interface->getConnectionState() != KodiInterface::ConnectionState::connected)
+		{
+			interface->stopListening();
+			interface->unsubscribe(subscriber.id);
+			return BaseLib::Variable::createError(-32500, "Could not connect to Kodi.");
+		}
+
+		uint64_t requests = 0;
+		int64_t cpuStartTime = getCpuTime();
+		auto startTime = std::chrono::steady_clock::now();
+		auto endTime = startTime + std::chrono::milliseconds(duration);
+		auto requestInterval = std::chrono::microseconds(requestRate > 0 ? 1000000 / requestRate : 0);
+		auto nextRequest = startTime;
+		while(std::chrono::steady_clock::now() < endTime)
+		{
+			if(requestRate <= 0)
+			{
+				std::this_thread::sleep_until(endTime);
+				break;
+			}
+			std::this_thread::sleep_until(nextRequest);
+			nextRequest += requestInterval;
+
+			auto request = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+			request->structValue->emplace("jsonrpc", std::make_shared<BaseLib::Variable>(std::string("2.0")));
+			request->structValue->emplace("method", std::make_shared<BaseLib::Variable>(std::string("JSONRPC.Ping")));
+			auto sendTime = std::chrono::steady_clock::now();
+			if(interface->sendRequest(request, [state, sendTime](const BaseLib::PVariable& response) {
+				if(!response) return;
+				state->responses++;
+				state->roundTripTimes.add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - sendTime).count());
+			})) requests++;
+		}
+		int64_t elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+		int64_t cpuTime = getCpuTime() - cpuStartTime;
+		uint64_t notifications = state->notifications;
+		uint64_t responses = state->responses;
+
+		interface->stopListening();
+		interface->unsubscribe(subscriber.id);
+
+		auto result = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+		result->structValue->emplace("duration", std::make_shared<BaseLib::Variable>(elapsed));
+		result->structValue->emplace("notifications", std::make_shared<BaseLib::Variable>((int64_t)notifications));
+		result->structValue->emplace("notificationsPerSecond", std::make_shared<BaseLib::Variable>(elapsed > 0 ? (double)notifications * 1000000 / elapsed : 0.0));
+		result->structValue->emplace("requests", std::make_shared<BaseLib::Variable>((int64_t)requests));
+		result->structValue->emplace("responses", std::make_shared<BaseLib::Variable>((int64_t)responses));
+		result->structValue->emplace("roundTripTimeMedian", std::make_shared<BaseLib::Variable>(state->roundTripTimes.percentile(50)));
+		result->structValue->emplace("roundTripTimeP95", std::make_shared<BaseLib::Variable>(state->roundTripTimes.percentile(95)));
+		result->structValue->emplace("roundTripTimeP99", std::make_shared<BaseLib::Variable>(state->roundTripTimes.percentile(99)));
+		result->structValue->emplace("cpuTime", std::make_shared<BaseLib::Variable>(cpuTime));
+		result->structValue->emplace("cpuTimePerMessage", std::make_shared<BaseLib::Variable>(notifications + responses > 0 ? (double)cpuTime / (notifications + responses) : 0.0));
+		result->structValue->emplace("metrics", interface->getMetrics());
+		return result;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return BaseLib::Variable::createError(-32500, "Unknown application error.");
+}
+
+}
@@ -0,0 +1,62 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODIBENCHMARK_H_
+#define KODIBENCHMARK_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <string>
+
+namespace Kodi
+{
+
+/**
+ * Load generator measuring the receive and request path of KodiInterface against a Kodi instance, usually KodiMockServer.
+ */
+class KodiBenchmark
+{
+public:
+	KodiBenchmark() = default;
+	virtual ~KodiBenchmark() = default;
+
+	/**
+	 * Connects a new KodiInterface to "hostname" and "port", sends "JSONRPC.Ping" at "requestRate" requests per second and counts
+	 * all notifications received during "duration" milliseconds.
+	 *
+	 * @return Returns a struct with the number of notifications and notifications per second, the number of requests and
+	 * responses, the round trip time percentiles in microseconds and the CPU time of the process per received message in
+	 * microseconds or an error.
+	 */
+	BaseLib::PVariable run(const std::string& hostname, int32_t port, int64_t duration, int32_t requestRate);
+};
+
+}
+
+#endif
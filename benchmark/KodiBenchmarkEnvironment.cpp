@@ -0,0 +1,82 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiBenchmarkEnvironment.h"
+#include "GD.h"
+
+#include <atomic>
+#include <csignal>
+#include <thread>
+
+namespace Kodi
+{
+
+namespace
+{
+std::atomic_bool stop{false};
+
+void signalHandler(int signalNumber)
+{
+	stop = true;
+}
+}
+
+KodiBenchmarkEnvironment::KodiBenchmarkEnvironment(int32_t workerCount)
+{
+	std::signal(SIGINT, signalHandler);
+	std::signal(SIGTERM, signalHandler);
+
+	_bl.reset(new BaseLib::SharedObjects());
+	_bl->debugLevel = 3;
+	//The constructor sets GD::bl, GD::family and creates the event loop.
+	_family.reset(new Kodi(_bl.get(), nullptr));
+	GD::eventLoop->start(workerCount);
+}
+
+KodiBenchmarkEnvironment::~KodiBenchmarkEnvironment()
+{
+	if(_family) _family->dispose();
+	_family.reset();
+	GD::family = nullptr;
+}
+
+bool KodiBenchmarkEnvironment::stopRequested()
+{
+	return stop;
+}
+
+void KodiBenchmarkEnvironment::waitForSignal()
+{
+	while(!stop)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+}
+
+}
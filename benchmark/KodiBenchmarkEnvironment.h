@@ -0,0 +1,69 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODIBENCHMARKENVIRONMENT_H_
+#define KODIBENCHMARKENVIRONMENT_H_
+
+#include <homegear-base/BaseLib.h>
+#include "Kodi.h"
+
+#include <memory>
+
+namespace Kodi
+{
+
+/**
+ * Runs the module outside of Homegear for the benchmark executables. Creates the shared objects and the device family without a
+ * Homegear instance and starts the event loop. No database is opened, so peers are never saved.
+ */
+class KodiBenchmarkEnvironment
+{
+public:
+	/**
+	 * @param workerCount The number of event loop worker threads.
+	 */
+	explicit KodiBenchmarkEnvironment(int32_t workerCount = 2);
+	virtual ~KodiBenchmarkEnvironment();
+
+	BaseLib::SharedObjects* getBaseLib() { return _bl.get(); }
+	Kodi* getFamily() { return _family.get(); }
+
+	/**
+	 * Returns true after SIGINT or SIGTERM was received. waitForSignal() blocks until then.
+	 */
+	static bool stopRequested();
+	static void waitForSignal();
+private:
+	std::unique_ptr<BaseLib::SharedObjects> _bl;
+	std::unique_ptr<Kodi> _family;
+};
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiBenchmarkEnvironment.h"
+#include "KodiBenchmark.h"
+#include "KodiInterface.h"
+
+#include <iomanip>
+#include <iostream>
+
+using namespace Kodi;
+
+void printHelp()
+{
+	std::cout << "Usage: kodi_benchmark HOSTNAME [PORT] [SECONDS] [RATE]" << std::endl << std::endl;
+	std::cout << "Connects to Kodi (usually kodi_mock), sends \"JSONRPC.Ping\" at a fixed rate and counts the received notifications." << std::endl << std::endl;
+	std::cout << "Parameters:" << std::endl;
+	std::cout << "  HOSTNAME:\tThe hostname or IP address of Kodi. Example: localhost" << std::endl;
+	std::cout << "  PORT:\t\tThe port of Kodi. Default: 9090" << std::endl;
+	std::cout << "  SECONDS:\tThe duration of the benchmark. Default: 10" << std::endl;
+	std::cout << "  RATE:\t\tThe number of requests per second. Default: 100" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	std::string hostname;
+	int32_t port = 9090;
+	int32_t duration = 10;
+	int32_t requestRate = 100;
+	for(int32_t i = 1; i < argc; i++)
+	{
+		std::string argument(argv[i]);
+		if(argument == "-h" || argument == "--help")
+		{
+			printHelp();
+			return 0;
+		}
+		if(i == 1) hostname = argument;
+		else if(i == 2) port = BaseLib::Math::getNumber(argument, false);
+		else if(i == 3) duration = BaseLib::Math::getNumber(argument, false);
+		else if(i == 4) requestRate = BaseLib::Math::getNumber(argument, false);
+	}
+	if(hostname.empty())
+	{
+		printHelp();
+		return 1;
+	}
+	if(port < 1 || port > 65535)
+	{
+		std::cerr << "Invalid port." << std::endl;
+		return 1;
+	}
+	if(duration < 1)
+	{
+		std::cerr << "Invalid duration." << std::endl;
+		return 1;
+	}
+
+	KodiBenchmarkEnvironment environment;
+	KodiBenchmark benchmark;
+	BaseLib::PVariable result = benchmark.run(hostname, port, (int64_t)duration * 1000, requestRate);
+	if(result->errorStruct)
+	{
+		std::cerr << "Error: " << result->structValue->at("faultString")->stringValue << std::endl;
+		return 1;
+	}
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << "Notifications:        " << result->structValue->at("notifications")->integerValue64 << " (" << result->structValue->at("notificationsPerSecond")->floatValue << "/s)" << std::endl;
+	std::cout << "Requests:             " << result->structValue->at("requests")->integerValue64 << std::endl;
+	std::cout << "Responses:            " << result->structValue->at("responses")->integerValue64 << std::endl;
+	std::cout << "Round trip time (us): median " << result->structValue->at("roundTripTimeMedian")->integerValue64 << ", p95 " << result->structValue->at("roundTripTimeP95")->integerValue64 << ", p99 " << result->structValue->at("roundTripTimeP99")->integerValue64 << std::endl;
+	std::cout << "CPU time (us):        " << result->structValue->at("cpuTime")->integerValue64 << " (" << result->structValue->at("cpuTimePerMessage")->floatValue << " per message)" << std::endl;
+	std::cout << std::endl << KodiInterface::printMetrics(result->structValue->at("metrics"));
+	return 0;
+}
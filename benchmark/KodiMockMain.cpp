@@ -0,0 +1,86 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiBenchmarkEnvironment.h"
+#include "KodiMockServer.h"
+
+#include <iostream>
+
+using namespace Kodi;
+
+void printHelp()
+{
+	std::cout << "Usage: kodi_mock [PORT] [RATE] [LATENCY]" << std::endl << std::endl;
+	std::cout << "Starts a simulated Kodi listening for JSON-RPC connections. It answers all requests and sends the notifications known to the module at a fixed rate to every client. Stop it with Ctrl+C." << std::endl << std::endl;
+	std::cout << "Parameters:" << std::endl;
+	std::cout << "  PORT:\t\tThe port to listen on. Default: 9090" << std::endl;
+	std::cout << "  RATE:\t\tThe number of notifications per second and client. Default: 100" << std::endl;
+	std::cout << "  LATENCY:\tThe delay of responses in milliseconds. Default: 0" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	int32_t port = 9090;
+	int32_t notificationRate = 100;
+	int32_t responseLatency = 0;
+	for(int32_t i = 1; i < argc; i++)
+	{
+		std::string argument(argv[i]);
+		if(argument == "-h" || argument == "--help")
+		{
+			printHelp();
+			return 0;
+		}
+		if(i == 1) port = BaseLib::Math::getNumber(argument, false);
+		else if(i == 2) notificationRate = BaseLib::Math::getNumber(argument, false);
+		else if(i == 3) responseLatency = BaseLib::Math::getNumber(argument, false);
+	}
+	if(port < 1 || port > 65535)
+	{
+		std::cerr << "Invalid port." << std::endl;
+		return 1;
+	}
+
+	KodiBenchmarkEnvironment environment;
+	auto mockServer = std::make_shared<KodiMockServer>();
+	if(!mockServer->start(port, notificationRate, responseLatency))
+	{
+		std::cerr << "Could not start mock server." << std::endl;
+		return 1;
+	}
+	std::cout << "Mock server listening on port " << port << "." << std::endl;
+
+	KodiBenchmarkEnvironment::waitForSignal();
+
+	std::cout << "Clients:            " << mockServer->getClientCount() << std::endl;
+	std::cout << "Notifications sent: " << mockServer->getNotificationsSent() << std::endl;
+	std::cout << "Responses sent:     " << mockServer->getResponsesSent() << std::endl;
+	mockServer->stop();
+	return 0;
+}
@@ -0,0 +1,380 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiMockServer.h"
+#include "GD.h"
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace Kodi
+{
+
+namespace
+{
+//Interval of the notification timer in milliseconds.
+const int64_t notificationInterval = 10;
+
+std::string getNotification(uint64_t index)
+{
+	switch(index % 7)
+	{
+		case 0: return R"({"jsonrpc":"2.0","method":"Player.OnPlay","params":{"data":{"item":{"id":1,"type":"movie"},"player":{"playerid":1,"speed":1}},"sender":"xbmc"}})";
+		case 1: return R"({"jsonrpc":"2.0","method":"Player.OnPause","params":{"data":{"item":{"id":1,"type":"movie"},"player":{"playerid":1,"speed":0}},"sender":"xbmc"}})";
+		case 2: return R"({"jsonrpc":"2.0","method":"Player.OnResume","params":{"data":{"item":{"id":1,"type":"movie"},"player":{"playerid":1,"speed":1}},"sender":"xbmc"}})";
+		case 3: return R"({"jsonrpc":"2.0","method":"Player.OnStop","params":{"data":{"end":false,"item":{"id":1,"type":"movie"}},"sender":"xbmc"}})";
+		case 4: return R"({"jsonrpc":"2.0","method":"GUI.OnScreensaverActivated","params":{"data":null,"sender":"xbmc"}})";
+		case 5: return R"({"jsonrpc":"2.0","method":"GUI.OnScreensaverDeactivated","params":{"data":{"shuttingdown":false},"sender":"xbmc"}})";
+		default: return R"({"jsonrpc":"2.0","method":"Application.OnVolumeChanged","params":{"data":{"muted":false,"volume":)" + std::to_string(index % 101) + R"(},"sender":"xbmc"}})";
+	}
+}
+}
+
+KodiMockServer::KodiMockServer()
+{
+	_out.init(GD::bl);
+	_out.setPrefix(GD::out.getPrefix() + "Kodi mock server: ");
+}
+
+KodiMockServer::~KodiMockServer()
+{
+	stop();
+}
+
+bool KodiMockServer::start(int32_t port, int32_t notificationRate, int32_t responseLatency)
+{
+	try
+	{
+		stop();
+		if(!GD::eventLoop) return false;
+		int32_t listenSocket = ::socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		if(listenSocket == -1)
+		{
+			_out.printError("Error: Could not create socket: " + std::string(strerror(errno)));
+			return false;
+		}
+		int32_t reuseAddress = 1;
+		setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+		int32_t v6Only = 0;
+		setsockopt(listenSocket, IPPROTO_IPV6, IPV6_V6ONLY, &v6Only, sizeof(v6Only));
+		struct sockaddr_in6 address{};
+		address.sin6_family = AF_INET6;
+		address.sin6_addr = in6addr_any;
+		address.sin6_port = htons(port);
+		if(::bind(listenSocket, (struct sockaddr*)&address, sizeof(address)) == -1 || ::listen(listenSocket, 16) == -1)
+		{
+			_out.printError("Error: Could not listen on port " + std::to_string(port) + ": " + std::string(strerror(errno)));
+			::close(listenSocket);
+			return false;
+		}
+
+		std::lock_guard<std::mutex> stateGuard(_stateMutex);
+		_listenSocket = listenSocket;
+		_port = port;
+		_notificationRate = notificationRate < 0 ? 0 : notificationRate;
+		_responseLatency = responseLatency < 0 ? 0 : responseLatency;
+		_notificationsSent = 0;
+		_responsesSent = 0;
+		_notificationIndex = 0;
+		std::weak_ptr<KodiMockServer> weakServer = shared_from_this();
+		_listenRegistrationId = GD::eventLoop->add(listenSocket, EPOLLIN, [weakServer](uint32_t events) {
+			auto server = weakServer.lock();
+			if(server) server->acceptClients();
+		});
+		if(_notificationRate > 0)
+		{
+			_startTime = BaseLib::HelperFunctions::getTime();
+			scheduleNotifications();
+		}
+		_out.printInfo("Info: Listening on port " + std::to_string(port) + ".");
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
+
+void KodiMockServer::stop()
+{
+	try
+	{
+		int32_t listenSocket = -1;
+		uint64_t listenRegistrationId = 0;
+		{
+			std::lock_guard<std::mutex> stateGuard(_stateMutex);
+			if(_listenSocket == -1) return;
+			listenSocket = _listenSocket;
+			listenRegistrationId = _listenRegistrationId;
+			_listenSocket = -1;
+			_listenRegistrationId = 0;
+			if(GD::eventLoop) GD::eventLoop->removeTimer(_notificationTimerId);
+			_notificationTimerId = 0;
+		}
+		if(GD::eventLoop) GD::eventLoop->remove(listenRegistrationId, true);
+		::close(listenSocket);
+
+		std::unordered_map<uint64_t, PClient> clients;
+		{
+			std::lock_guard<std::mutex> clientsGuard(_clientsMutex);
+			clients.swap(_clients);
+		}
+		for(auto& client : clients)
+		{
+			closeClient(client.second, true);
+		}
+		_out.printInfo("Info: Stopped.");
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+size_t KodiMockServer::getClientCount()
+{
+	std::lock_guard<std::mutex> clientsGuard(_clientsMutex);
+	return _clients.size();
+}
+
+void KodiMockServer::acceptClients()
+{
+	try
+	{
+		std::lock_guard<std::mutex> stateGuard(_stateMutex);
+		if(_listenSocket == -1) return;
+		while(true)
+		{
+			int32_t socketDescriptor = ::accept4(_listenSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if(socketDescriptor == -1)
+			{
+				if(errno == EINTR) continue;
+				break;
+			}
+
+			auto client = std::make_shared<Client>();
+			client->socketDescriptor = socketDescriptor;
+			std::weak_ptr<KodiMockServer> weakServer = shared_from_this();
+			std::weak_ptr<Client> weakClient = client;
+			//Registered while holding the lock, so the callback can't run before the registration id is set.
+			std::lock_guard<std::mutex> clientsGuard(_clientsMutex);
+			client->registrationId = GD::eventLoop->add(socketDescriptor, EPOLLIN | EPOLLRDHUP, [weakServer, weakClient](uint32_t events) {
+				auto server = weakServer.lock();
+				auto client = weakClient.lock();
+				if(server && client) server->readClient(client);
+			});
+			if(client->registrationId == 0)
+			{
+				::close(socketDescriptor);
+				continue;
+			}
+			_clients.emplace(client->registrationId, client);
+			_out.printInfo("Info: Client connected.");
+		}
+		GD::eventLoop->rearm(_listenRegistrationId, EPOLLIN);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void KodiMockServer::closeClient(const PClient& client, bool wait)
+{
+	if(client->closed.exchange(true)) return;
+	{
+		std::lock_guard<std::mutex> clientsGuard(_clientsMutex);
+		_clients.erase(client->registrationId);
+	}
+	if(GD::eventLoop) GD::eventLoop->remove(client->registrationId, wait);
+	std::lock_guard<std::mutex> sendGuard(client->sendMutex);
+	::shutdown(client->socketDescriptor, SHUT_RDWR);
+	::close(client->socketDescriptor);
+}
+
+void KodiMockServer::readClient(const PClient& client)
+{
+	try
+	{
+		if(client->closed) return;
+		while(true)
+		{
+			size_t bufferSize = 0;
+			char* buffer = client->framer.getWriteBuffer(bufferSize);
+			ssize_t receivedBytes = ::recv(client->socketDescriptor, buffer, bufferSize, 0);
+			if(receivedBytes > 0)
+			{
+				client->framer.commit(receivedBytes);
+				continue;
+			}
+			if(receivedBytes == -1 && errno == EINTR) continue;
+			if(receivedBytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+			_out.printInfo("Info: Client disconnected.");
+			closeClient(client, false);
+			return;
+		}
+
+		client->framer.process([&](const char* data, size_t size) {
+			if(!client->document.parse(data, size)) return;
+			uint32_t root = client->document.root();
+			if(client->document.node(root).type == KodiJsonDocument::Type::array)
+			{
+				std::string response;
+				for(uint32_t element = client->document.node(root).firstChild; element != KodiJsonDocument::npos; element = client->document.node(element).nextSibling)
+				{
+					std::string elementResponse = getResponse(client->document, element);
+					if(elementResponse.empty()) continue;
+					response.append(response.empty() ? "[" : ",");
+					response.append(elementResponse);
+				}
+				if(!response.empty()) sendResponse(client, response + "]");
+			}
+			else
+			{
+				std::string response = getResponse(client->document, root);
+				if(!response.empty()) sendResponse(client, std::move(response));
+			}
+			client->document.clear();
+		});
+		GD::eventLoop->rearm(client->registrationId, EPOLLIN | EPOLLRDHUP);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+std::string KodiMockServer::getResponse(const KodiJsonDocument& document, uint32_t index)
+{
+	if(document.node(index).type != KodiJsonDocument::Type::object) return "";
+	uint32_t idIndex = document.find(index, "id");
+	if(idIndex == KodiJsonDocument::npos || document.node(idIndex).type != KodiJsonDocument::Type::number) return "";
+	uint32_t methodIndex = document.find(index, "method");
+	std::string method = methodIndex == KodiJsonDocument::npos ? "" : document.getString(methodIndex);
+	std::string result = (method == "JSONRPC.Ping") ? "\"pong\"" : "\"OK\"";
+	return "{\"id\":" + std::string(document.node(idIndex).value) + ",\"jsonrpc\":\"2.0\",\"result\":" + result + "}";
+}
+
+void KodiMockServer::sendResponse(const PClient& client, std::string response)
+{
+	if(_responseLatency <= 0)
+	{
+		if(send(client, response)) _responsesSent++;
+		return;
+	}
+	std::weak_ptr<KodiMockServer> weakServer = shared_from_this();
+	std::weak_ptr<Client> weakClient = client;
+	GD::eventLoop->addTimer(_responseLatency, [weakServer, weakClient, response]() {
+		auto server = weakServer.lock();
+		auto client = weakClient.lock();
+		if(server && client && server->send(client, response)) server->_responsesSent++;
+	});
+}
+
+bool KodiMockServer::send(const PClient& client, const std::string& data)
+{
+	std::lock_guard<std::mutex> sendGuard(client->sendMutex);
+	if(client->closed) return false;
+	size_t totalBytesWritten = 0;
+	while(totalBytesWritten < data.size())
+	{
+		ssize_t bytesWritten = ::send(client->socketDescriptor, data.data() + totalBytesWritten, data.size() - totalBytesWritten, MSG_NOSIGNAL);
+		if(bytesWritten == -1)
+		{
+			if(errno == EINTR) continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				struct pollfd pollInfo{};
+				pollInfo.fd = client->socketDescriptor;
+				pollInfo.events = POLLOUT;
+				if(::poll(&pollInfo, 1, 1000) > 0) continue;
+			}
+			return false;
+		}
+		totalBytesWritten += bytesWritten;
+	}
+	return true;
+}
+
+void KodiMockServer::scheduleNotifications()
+{
+	//Must be called with _stateMutex locked.
+	std::weak_ptr<KodiMockServer> weakServer = shared_from_this();
+	_notificationTimerId = GD::eventLoop->addTimer(notificationInterval, [weakServer]() {
+		auto server = weakServer.lock();
+		if(server) server->sendNotifications();
+	});
+}
+
+void KodiMockServer::sendNotifications()
+{
+	try
+	{
+		int64_t startTime = 0;
+		{
+			std::lock_guard<std::mutex> stateGuard(_stateMutex);
+			if(_listenSocket == -1) return;
+			startTime = _startTime;
+		}
+
+		std::vector<PClient> clients;
+		{
+			std::lock_guard<std::mutex> clientsGuard(_clientsMutex);
+			clients.reserve(_clients.size());
+			for(auto& client : _clients)
+			{
+				clients.push_back(client.second);
+			}
+		}
+
+		//The number of notifications due is calculated from the start time, so timer jitter doesn't change the rate.
+		uint64_t due = (uint64_t)((BaseLib::HelperFunctions::getTime() - startTime) * (int64_t)_notificationRate / 1000);
+		for(; _notificationIndex < due; _notificationIndex++)
+		{
+			std::string notification = getNotification(_notificationIndex);
+			for(auto& client : clients)
+			{
+				if(send(client, notification)) _notificationsSent++;
+			}
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	//Scheduled after sending, so the timer never runs twice at the same time.
+	std::lock_guard<std::mutex> stateGuard(_stateMutex);
+	if(_listenSocket != -1) scheduleNotifications();
+}
+
+}
@@ -0,0 +1,116 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODIMOCKSERVER_H_
+#define KODIMOCKSERVER_H_
+
+#include <homegear-base/BaseLib.h>
+#include "KodiJsonDocument.h"
+#include "KodiJsonFramer.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Kodi
+{
+
+/**
+ * Minimal Kodi for benchmarks and tests without a real Kodi instance. Accepts TCP connections speaking Kodi's JSON-RPC protocol,
+ * answers every request (also batches) with "OK" ("pong" for "JSONRPC.Ping") and sends the notifications handled in Kodi.xml at
+ * a fixed rate. Runs on the module's event loop.
+ */
+class KodiMockServer : public std::enable_shared_from_this<KodiMockServer>
+{
+public:
+	KodiMockServer();
+	virtual ~KodiMockServer();
+
+	/**
+	 * @param port The TCP port to listen on.
+	 * @param notificationRate The number of notifications per second sent to every client. "0" disables notifications.
+	 * @param responseLatency The delay in milliseconds before a response is sent.
+	 */
+	bool start(int32_t port, int32_t notificationRate, int32_t responseLatency);
+	void stop();
+	bool isRunning() { return _listenSocket != -1; }
+	int32_t getPort() { return _port; }
+	size_t getClientCount();
+	uint64_t getNotificationsSent() { return _notificationsSent; }
+	uint64_t getResponsesSent() { return _responsesSent; }
+private:
+	struct Client
+	{
+		int32_t socketDescriptor = -1;
+		uint64_t registrationId = 0;
+		KodiJsonFramer framer;
+		KodiJsonDocument document;
+		std::mutex sendMutex;
+		std::atomic_bool closed{false};
+	};
+	typedef std::shared_ptr<Client> PClient;
+
+	BaseLib::Output _out;
+	std::mutex _stateMutex;
+	int32_t _listenSocket = -1;
+	uint64_t _listenRegistrationId = 0;
+	uint64_t _notificationTimerId = 0;
+	int32_t _port = 9090;
+	int32_t _notificationRate = 0;
+	int32_t _responseLatency = 0;
+	int64_t _startTime = 0;
+
+	//Only used by sendNotifications()
+	uint64_t _notificationIndex = 0;
+
+	std::mutex _clientsMutex;
+	std::unordered_map<uint64_t, PClient> _clients;
+
+	std::atomic<uint64_t> _notificationsSent{0};
+	std::atomic<uint64_t> _responsesSent{0};
+
+	void acceptClients();
+	void readClient(const PClient& client);
+	void closeClient(const PClient& client, bool wait);
+
+	/**
+	 * @return Returns the serialized response or an empty string when the message has no id.
+	 */
+	std::string getResponse(const KodiJsonDocument& document, uint32_t index);
+	void sendResponse(const PClient& client, std::string response);
+	bool send(const PClient& client, const std::string& data);
+	void scheduleNotifications();
+	void sendNotifications();
+};
+
+}
+
+#endif
@@ -0,0 +1,154 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiPeerBenchmark.h"
+#include "GD.h"
+#include "KodiAllocationCounter.h"
+#include "KodiJsonDocument.h"
+#include "KodiPacket.h"
+
+#include <chrono>
+#include <functional>
+#include <iomanip>
+
+namespace Kodi
+{
+
+KodiPeerBenchmark::KodiPeerBenchmark(uint32_t parentID, IPeerEventSink* eventHandler) : KodiPeer(parentID, eventHandler)
+{
+}
+
+KodiPeerBenchmark::~KodiPeerBenchmark()
+{
+}
+
+std::string KodiPeerBenchmark::run(int32_t iterations)
+{
+	try
+	{
+		//Representative notifications as sent by Kodi
+		const std::vector<std::string> notifications
+		{
+			R"({"jsonrpc":"2.0","method":"Player.OnPlay","params":{"data":{"item":{"id":1,"type":"movie"},"player":{"playerid":1,"speed":1}},"sender":"xbmc"}})",
+			R"({"jsonrpc":"2.0","method":"Application.OnVolumeChanged","params":{"data":{"muted":false,"volume":42},"sender":"xbmc"}})",
+			R"({"jsonrpc":"2.0","method":"GUI.OnScreensaverActivated","params":{"data":null,"sender":"xbmc"}})"
+		};
+
+		std::ostringstream stringStream;
+		stringStream << std::left << std::setw(30) << "Notification" << std::setw(28) << "getValuesFromPacket" << std::setw(28) << "packetReceived" << "Value conversion" << std::endl;
+		stringStream << std::setw(30) << "" << std::setw(14) << "ns/op" << std::setw(14) << "allocs/op" << std::setw(14) << "ns/op" << std::setw(14) << "allocs/op" << std::setw(14) << "direct ns/op" << "generic ns/op" << std::endl;
+		for(auto& notification : notifications)
+		{
+			KodiJsonDocument document;
+			if(!document.parse(notification.data(), notification.size())) continue;
+			std::string method;
+			{
+				KodiPacket packet(document, document.root());
+				method = packet.getMethod();
+			}
+
+			//Runs "function" with a new packet per iteration, because packets cache converted values.
+			auto measure = [&](const std::function<void(KodiPacket& packet)>& function, int64_t& nanoseconds, double& allocations)
+			{
+				uint64_t allocationCount = KodiAllocationCounter::count();
+				auto startTime = std::chrono::steady_clock::now();
+				for(int32_t i = 0; i < iterations; i++)
+				{
+					KodiPacket packet(document, document.root());
+					function(packet);
+				}
+				nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count() / iterations;
+				allocations = (double)(KodiAllocationCounter::count() - allocationCount) / iterations;
+			};
+
+			int64_t extractionTime = 0;
+			double extractionAllocations = 0;
+			measure([&](KodiPacket& packet)
+			{
+				std::vector<FrameValues> frameValues;
+				getValuesFromPacket(packet, frameValues);
+			}, extractionTime, extractionAllocations);
+
+			int64_t processingTime = 0;
+			double processingAllocations = 0;
+			measure([&](KodiPacket& packet) { packetReceived(packet); }, processingTime, processingAllocations);
+
+			//Converts all bound values of the notification with the parameter's converter and through the generic path.
+			std::vector<std::pair<BaseLib::PVariable, const KodiValueConverter*>> conversions;
+			std::unordered_map<std::string, std::vector<NotificationFrame>>::const_iterator tableIterator = _notificationTable.find(method);
+			if(tableIterator != _notificationTable.end())
+			{
+				KodiPacket packet(document, document.root());
+				for(const NotificationFrame& frame : tableIterator->second)
+				{
+					for(const NotificationBinding& binding : frame.bindings)
+					{
+						BaseLib::PVariable value = binding.constValue ? binding.constValue : packet.getValue(binding.keyPath);
+						if(!value) continue;
+						for(const NotificationTarget& target : binding.targets)
+						{
+							conversions.emplace_back(value, &target.converter);
+						}
+					}
+				}
+			}
+			auto measureConversion = [&](bool generic)
+			{
+				std::vector<uint8_t> data;
+				auto startTime = std::chrono::steady_clock::now();
+				for(int32_t i = 0; i < iterations; i++)
+				{
+					for(auto& conversion : conversions)
+					{
+						if(generic) conversion.second->convertGeneric(conversion.first, *_binaryEncoder, data);
+						else conversion.second->convert(conversion.first, *_binaryEncoder, data);
+					}
+				}
+				return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count() / iterations;
+			};
+			int64_t directConversionTime = measureConversion(false);
+			int64_t genericConversionTime = measureConversion(true);
+
+			stringStream << std::setw(30) << method << std::setw(14) << extractionTime << std::setw(14);
+			if(KodiAllocationCounter::enabled()) stringStream << extractionAllocations; else stringStream << "-";
+			stringStream << std::setw(14) << processingTime;
+			stringStream << std::setw(14);
+			if(KodiAllocationCounter::enabled()) stringStream << processingAllocations; else stringStream << "-";
+			stringStream << std::setw(14) << directConversionTime << genericConversionTime << std::endl;
+		}
+		return stringStream.str();
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    return "Error running the benchmark. See log file for more details.\n";
+}
+
+}
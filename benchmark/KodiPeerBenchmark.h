@@ -0,0 +1,59 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODIPEERBENCHMARK_H_
+#define KODIPEERBENCHMARK_H_
+
+#include "KodiPeer.h"
+
+namespace Kodi
+{
+
+/**
+ * Measures the notification processing of a peer with representative notifications. The peer has the id 0, so BaseLib never
+ * writes its parameters to the database. Events are raised to the central, which has no event handler, so they end there.
+ */
+class KodiPeerBenchmark : public KodiPeer
+{
+public:
+	KodiPeerBenchmark(uint32_t parentID, IPeerEventSink* eventHandler);
+	virtual ~KodiPeerBenchmark();
+
+	/**
+	 * Measures getValuesFromPacket(), packetReceived() and the value conversion.
+	 *
+	 * @param iterations The number of times each notification is processed.
+	 * @return Returns the result table.
+	 */
+	std::string run(int32_t iterations);
+};
+
+}
+
+#endif
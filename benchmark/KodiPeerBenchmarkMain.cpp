@@ -0,0 +1,95 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiBenchmarkEnvironment.h"
+#include "KodiPeerBenchmark.h"
+#include "KodiCentral.h"
+#include "KodiAllocationCounter.h"
+
+#include <iostream>
+
+using namespace Kodi;
+
+void printHelp()
+{
+	std::cout << "Usage: kodi_peer_benchmark [ITERATIONS] [DEVICE_DESCRIPTION_FILE]" << std::endl << std::endl;
+	std::cout << "Runs representative notifications through the notification processing of a peer. Nothing is written to the database." << std::endl << std::endl;
+	std::cout << "Parameters:" << std::endl;
+	std::cout << "  ITERATIONS:\t\t\tThe number of times each notification is processed. Default: 100000" << std::endl;
+	std::cout << "  DEVICE_DESCRIPTION_FILE:\tThe path to \"Kodi.xml\". Default: misc/Device Description Files/Kodi.xml" << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+	int32_t iterations = 100000;
+	std::string deviceDescriptionFile = "misc/Device Description Files/Kodi.xml";
+	for(int32_t i = 1; i < argc; i++)
+	{
+		std::string argument(argv[i]);
+		if(argument == "-h" || argument == "--help")
+		{
+			printHelp();
+			return 0;
+		}
+		if(i == 1) iterations = BaseLib::Math::getNumber(argument, false);
+		else if(i == 2) deviceDescriptionFile = argument;
+	}
+	if(iterations < 1)
+	{
+		std::cerr << "Invalid number of iterations." << std::endl;
+		return 1;
+	}
+
+	KodiBenchmarkEnvironment environment;
+	bool oldFormat = false;
+	std::shared_ptr<BaseLib::DeviceDescription::HomegearDevice> rpcDevice = std::make_shared<BaseLib::DeviceDescription::HomegearDevice>(environment.getBaseLib(), deviceDescriptionFile, oldFormat);
+	if(!rpcDevice->loaded())
+	{
+		std::cerr << "Could not load device description file \"" << deviceDescriptionFile << "\"." << std::endl;
+		return 1;
+	}
+
+	//The central has no event handler, so the events of the peer end there.
+	std::shared_ptr<KodiCentral> central(new KodiCentral(0, "VKC0000001", nullptr));
+	//The peer keeps the id 0. BaseLib doesn't save parameters of such peers, which keeps the database out of the measurement.
+	std::shared_ptr<KodiPeerBenchmark> peer(new KodiPeerBenchmark(0, central.get()));
+	peer->setDeviceType(1);
+	peer->setSerialNumber("VKD0000001");
+	peer->setRpcDevice(rpcDevice);
+	peer->compileDeviceDescription();
+	peer->initializeCentralConfig();
+	peer->initializeEventMetadata();
+	peer->loadChangeFilter();
+
+	if(!KodiAllocationCounter::enabled()) std::cout << "Allocations are not counted, because the benchmark was built without KODI_COUNT_ALLOCATIONS." << std::endl << std::endl;
+	std::cout << peer->run(iterations);
+	peer->dispose();
+	central->dispose(false);
+	return 0;
+}
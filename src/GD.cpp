@@ -34,4 +34,7 @@ namespace Kodi
 	BaseLib::SharedObjects* GD::bl = nullptr;
 	Kodi* GD::family = nullptr;
 	BaseLib::Output GD::out;
+	std::unique_ptr<KodiEventLoop> GD::eventLoop;
+	std::unique_ptr<KodiConnectionRegistry> GD::connections;
+	std::unique_ptr<KodiPersistence> GD::persistence;
 }
@@ -35,6 +35,9 @@
 
 #include <homegear-base/BaseLib.h>
 #include "Kodi.h"
+#include "KodiEventLoop.h"
+#include "KodiConnectionRegistry.h"
+#include "KodiPersistence.h"
 
 namespace Kodi
 {
@@ -47,6 +50,9 @@ public:
 	static BaseLib::SharedObjects* bl;
 	static Kodi* family;
 	static BaseLib::Output out;
+	static std::unique_ptr<KodiEventLoop> eventLoop;
+	static std::unique_ptr<KodiConnectionRegistry> connections;
+	static std::unique_ptr<KodiPersistence> persistence;
 private:
 	GD();
 };
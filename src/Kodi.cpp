@@ -41,6 +41,9 @@ Kodi::Kodi(BaseLib::SharedObjects* bl, BaseLib::Systems::IFamilyEventSink* event
 	GD::out.init(bl);
 	GD::out.setPrefix(std::string("Module ") + MY_FAMILY_NAME + ": ");
 	GD::out.printDebug("Debug: Loading module...");
+	GD::eventLoop.reset(new KodiEventLoop());
+	GD::connections.reset(new KodiConnectionRegistry());
+	GD::persistence.reset(new KodiPersistence());
 }
 
 Kodi::~Kodi()
@@ -52,6 +55,10 @@ void Kodi::dispose()
 {
 	if(_disposed) return;
 	DeviceFamily::dispose();
+	if(GD::persistence) GD::persistence->stop();
+	if(GD::eventLoop) GD::eventLoop->stop();
+	GD::connections.reset();
+	GD::persistence.reset();
 
 	_central.reset();
 }
@@ -75,6 +82,21 @@ std::shared_ptr<BaseLib::Systems::ICentral> Kodi::initializeCentral(uint32_t dev
 	return std::shared_ptr<KodiCentral>(new KodiCentral(deviceId, serialNumber, this));
 }
 
+int32_t Kodi::getIntegerSetting(std::string name, int32_t defaultValue)
+{
+	try
+	{
+		auto setting = getFamilySetting(name);
+		if(!setting) return defaultValue;
+		return setting->integerValue;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return defaultValue;
+}
+
 PVariable Kodi::getPairingInfo()
 {
 	try
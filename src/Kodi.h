@@ -49,6 +49,14 @@ public:
 
 	virtual bool hasPhysicalInterface() { return false; }
 	virtual PVariable getPairingInfo();
+
+	/**
+	 * Returns the value of an integer setting in kodi.conf.
+	 *
+	 * @param name The lower case name of the setting.
+	 * @param defaultValue Returned when the setting is not set.
+	 */
+	int32_t getIntegerSetting(std::string name, int32_t defaultValue);
 protected:
 	virtual std::shared_ptr<BaseLib::Systems::ICentral> initializeCentral(uint32_t deviceId, int32_t address, std::string serialNumber);
 	virtual void createCentral();
@@ -0,0 +1,126 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiCapture.h"
+
+#include <chrono>
+
+namespace Kodi
+{
+
+namespace
+{
+const char captureMagic[8] = {'K', 'O', 'D', 'I', 'C', 'A', 'P', '1'};
+
+void appendInteger(char* buffer, uint64_t value, size_t size)
+{
+	for(size_t i = 0; i < size; i++)
+	{
+		buffer[i] = (char)(value >> (i * 8));
+	}
+}
+
+uint64_t readInteger(const char* buffer, size_t size)
+{
+	uint64_t value = 0;
+	for(size_t i = 0; i < size; i++)
+	{
+		value |= (uint64_t)(uint8_t)buffer[i] << (i * 8);
+	}
+	return value;
+}
+}
+
+KodiCapture::~KodiCapture()
+{
+	close();
+}
+
+int64_t KodiCapture::steadyTimeNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool KodiCapture::create(const std::string& path)
+{
+	std::lock_guard<std::mutex> fileGuard(_fileMutex);
+	if(_file.is_open()) _file.close();
+	_file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+	if(!_file.is_open()) return false;
+	_file.write(captureMagic, sizeof(captureMagic));
+	_startTime = steadyTimeNanoseconds();
+	return (bool)_file;
+}
+
+bool KodiCapture::open(const std::string& path)
+{
+	std::lock_guard<std::mutex> fileGuard(_fileMutex);
+	if(_file.is_open()) _file.close();
+	_file.open(path, std::ios::in | std::ios::binary);
+	if(!_file.is_open()) return false;
+	char magic[sizeof(captureMagic)];
+	if(!_file.read(magic, sizeof(magic)) || std::string(magic, sizeof(magic)) != std::string(captureMagic, sizeof(captureMagic)))
+	{
+		_file.close();
+		return false;
+	}
+	return true;
+}
+
+void KodiCapture::close()
+{
+	std::lock_guard<std::mutex> fileGuard(_fileMutex);
+	if(_file.is_open()) _file.close();
+}
+
+void KodiCapture::write(Direction direction, const char* data, size_t size)
+{
+	std::lock_guard<std::mutex> fileGuard(_fileMutex);
+	if(!_file.is_open()) return;
+	//The time is taken while holding the lock, so the records are in chronological order.
+	char header[13];
+	header[0] = (char)direction;
+	appendInteger(header + 1, steadyTimeNanoseconds() - _startTime, 8);
+	appendInteger(header + 9, size, 4);
+	_file.write(header, sizeof(header));
+	_file.write(data, size);
+}
+
+bool KodiCapture::read(Record& record)
+{
+	std::lock_guard<std::mutex> fileGuard(_fileMutex);
+	char header[13];
+	if(!_file.is_open() || !_file.read(header, sizeof(header))) return false;
+	record.direction = (Direction)header[0];
+	record.time = readInteger(header + 1, 8);
+	record.data.resize(readInteger(header + 9, 4));
+	return record.data.empty() || (bool)_file.read(record.data.data(), record.data.size());
+}
+
+}
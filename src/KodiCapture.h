@@ -0,0 +1,99 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODICAPTURE_H_
+#define KODICAPTURE_H_
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Kodi
+{
+
+/**
+ * Binary log of the traffic of one connection to Kodi. The file starts with the magic "KODICAP1". Every record consists of the
+ * direction (1 byte), the time in nanoseconds since the capture was started (8 bytes), the data length (4 bytes) and the data.
+ * Integers are little endian. Inbound records contain the data exactly as received from the socket, so frames can be split
+ * across records.
+ */
+class KodiCapture
+{
+public:
+	enum class Direction : uint8_t
+	{
+		inbound = 0,
+		outbound = 1
+	};
+
+	struct Record
+	{
+		Direction direction = Direction::inbound;
+		int64_t time = 0;
+		std::vector<char> data;
+	};
+
+	KodiCapture() = default;
+	virtual ~KodiCapture();
+
+	/**
+	 * Creates or truncates "path" and writes the file header.
+	 */
+	bool create(const std::string& path);
+
+	/**
+	 * Opens an existing capture for reading.
+	 */
+	bool open(const std::string& path);
+	void close();
+
+	/**
+	 * Appends a record. Thread safe.
+	 */
+	void write(Direction direction, const char* data, size_t size);
+
+	/**
+	 * Reads the next record. The data buffer of "record" is reused.
+	 *
+	 * @return Returns false at the end of the file or when the file is truncated.
+	 */
+	bool read(Record& record);
+private:
+	std::mutex _fileMutex;
+	std::fstream _file;
+	int64_t _startTime = 0;
+
+	static int64_t steadyTimeNanoseconds();
+};
+
+}
+
+#endif
@@ -68,6 +68,9 @@ void KodiCentral::init()
 	{
 		if(_initialized) return; //Prevent running init two times
 		_initialized = true;
+
+		if(GD::eventLoop) GD::eventLoop->start(GD::family->getIntegerSetting("eventloopworkers", 2));
+		if(GD::persistence) GD::persistence->start(GD::family->getIntegerSetting("persistenceinterval", 1000));
 	}
 	catch(const std::exception& ex)
 	{
@@ -189,6 +192,7 @@ void KodiCentral::deletePeer(uint64_t id)
 		}
 		if(i == 600) GD::out.printError("Error: Peer deletion took too long.");
 
+		if(GD::persistence) GD::persistence->discard(peer->getID());
 		peer->deleteFromDatabase();
 
 		GD::out.printMessage("Removed Kodi peer " + std::to_string(peer->getID()));
@@ -215,6 +219,7 @@ std::string KodiCentral::handleCliCommand(std::string command)
 			stringStream << "peers setname (pn)\tName a peer" << std::endl;
 			stringStream << "send\t\tSends a raw packet" << std::endl;
 			stringStream << "search (sp)\t\tSearches for new devices" << std::endl;
+			stringStream << "stats\t\t\tPrints the transport metrics of all connections to Kodi" << std::endl;
 			stringStream << "unselect (u)\t\tUnselect this device" << std::endl;
 			return stringStream.str();
 		}
@@ -262,6 +267,8 @@ std::string KodiCentral::handleCliCommand(std::string command)
 					_peersMutex.unlock();
 					peer->save(true, true, false);
 					peer->initializeCentralConfig();
+					peer->initializeEventMetadata();
+					peer->loadChangeFilter();
 					_peersMutex.lock();
 					_peersById[peer->getID()] = peer;
 					_peersMutex.unlock();
@@ -514,6 +521,54 @@ std::string KodiCentral::handleCliCommand(std::string command)
 			}
 			return stringStream.str();
 		}
+		else if(command.compare(0, 5, "stats") == 0)
+		{
+			std::stringstream stream(command);
+			std::string element;
+			int32_t index = 0;
+			while(std::getline(stream, element, ' '))
+			{
+				if(index < 1)
+				{
+					index++;
+					continue;
+				}
+				else if(index == 1)
+				{
+					if(element == "help")
+					{
+						stringStream << "Description: This command prints the transport metrics of every connection to Kodi, the sum of all counters and the metrics of the delayed database writes. Decode and flush times are in microseconds, request times in milliseconds." << std::endl;
+						stringStream << "Usage: stats" << std::endl << std::endl;
+						stringStream << "Parameters:" << std::endl;
+						stringStream << "  There are no parameters." << std::endl;
+						return stringStream.str();
+					}
+				}
+				index++;
+			}
+
+			if(!GD::connections) return "No connections.\n";
+			std::vector<std::shared_ptr<KodiInterface>> connections = GD::connections->getConnections();
+			std::map<std::string, int64_t> totals;
+			for(auto& connection : connections)
+			{
+				BaseLib::PVariable metrics = connection->getMetrics();
+				stringStream << connection->getHostname() << ":" << connection->getPort() << " (" << connection->subscriberCount() << " peers)" << std::endl;
+				stringStream << KodiInterface::printMetrics(metrics) << std::endl;
+				for(auto& metric : *metrics->structValue)
+				{
+					//Histograms can't be summed up.
+					if(metric.second->type != BaseLib::VariableType::tStruct) totals[metric.first] += metric.second->integerValue64;
+				}
+			}
+			stringStream << "Total (" << connections.size() << " connections)" << std::endl;
+			for(auto& total : totals)
+			{
+				stringStream << total.first << ": " << total.second << std::endl;
+			}
+			if(GD::persistence) stringStream << std::endl << "Persistence" << std::endl << KodiInterface::printMetrics(GD::persistence->getMetrics());
+			return stringStream.str();
+		}
 		else return "Unknown command.\n";
 	}
 	catch(const std::exception& ex)
@@ -532,7 +587,13 @@ std::shared_ptr<KodiPeer> KodiCentral::createPeer(std::string serialNumber, bool
 		peer->setSerialNumber(serialNumber);
 		peer->setRpcDevice(GD::family->getRpcDevices()->find(1, 0x10, -1));
 		if(!peer->getRpcDevice()) return std::shared_ptr<KodiPeer>();
-		if(save) peer->save(true, true, false); //Save and create peerID
+		peer->compileDeviceDescription();
+		if(save)
+		{
+			peer->save(true, true, false); //Save and create peerID
+			peer->initializeEventMetadata();
+			peer->loadChangeFilter();
+		}
 		return peer;
 	}
     catch(const std::exception& ex)
@@ -557,6 +618,8 @@ PVariable KodiCentral::createDevice(BaseLib::PRpcClientInfo clientInfo, int32_t
 			peer->save(true, true, false);
 			peer->initializeCentralConfig();
 			peer->setAddress(address); //Needs to be set again, so it is saved to CONFIG_PARAMETER IP_ADDRESS
+			peer->initializeEventMetadata();
+			peer->loadChangeFilter();
 			_peersMutex.lock();
 			_peersById[peer->getID()] = peer;
 			_peersBySerial[peer->getSerialNumber()] = peer;
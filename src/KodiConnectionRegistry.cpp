@@ -0,0 +1,139 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiConnectionRegistry.h"
+#include "GD.h"
+
+namespace Kodi
+{
+
+std::string KodiConnectionRegistry::getKey(const std::string& hostname, int32_t port)
+{
+	std::string key = hostname;
+	BaseLib::HelperFunctions::toLower(key);
+	return key + ':' + std::to_string(port);
+}
+
+std::shared_ptr<KodiInterface> KodiConnectionRegistry::acquire(const std::string& hostname, int32_t port, const KodiInterface::Subscriber& subscriber)
+{
+	try
+	{
+		std::shared_ptr<KodiInterface> interface;
+		bool created = false;
+		std::string key = getKey(hostname, port);
+		{
+			std::lock_guard<std::mutex> connectionsGuard(_connectionsMutex);
+			auto connectionIterator = _connections.find(key);
+			if(connectionIterator == _connections.end())
+			{
+				Connection connection;
+				connection.interface = std::make_shared<KodiInterface>();
+				std::string interfaceHostname = hostname;
+				connection.interface->setHostname(interfaceHostname);
+				connection.interface->setPort(port);
+				connectionIterator = _connections.emplace(key, std::move(connection)).first;
+				created = true;
+			}
+			interface = connectionIterator->second.interface;
+			//Keeps a concurrent release() from closing the connection until the subscriber was added.
+			connectionIterator->second.pendingSubscribers++;
+		}
+
+		//subscribe() calls the subscriber's callbacks, which raise events and save values. So it is called without holding the lock.
+		interface->subscribe(subscriber);
+		{
+			std::lock_guard<std::mutex> connectionsGuard(_connectionsMutex);
+			auto connectionIterator = _connections.find(key);
+			if(connectionIterator != _connections.end() && connectionIterator->second.interface == interface) connectionIterator->second.pendingSubscribers--;
+		}
+		if(created)
+		{
+			GD::out.printDebug("Debug: Opening connection to Kodi with hostname " + hostname + " on port " + std::to_string(port) + ".");
+			interface->startListening();
+		}
+		return interface;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return std::shared_ptr<KodiInterface>();
+}
+
+void KodiConnectionRegistry::release(const std::shared_ptr<KodiInterface>& interface, uint64_t subscriberId)
+{
+	try
+	{
+		if(!interface) return;
+		bool unused = false;
+		{
+			//Only the map is changed while the lock is held. Waiting for callbacks and closing the connection might take a while and
+			//would block acquire() and release() of all other connections.
+			std::lock_guard<std::mutex> connectionsGuard(_connectionsMutex);
+			unused = (interface->removeSubscriber(subscriberId) == 0);
+			if(unused)
+			{
+				auto connectionIterator = _connections.find(getKey(interface->getHostname(), interface->getPort()));
+				if(connectionIterator != _connections.end() && connectionIterator->second.interface == interface)
+				{
+					if(connectionIterator->second.pendingSubscribers > 0) unused = false;
+					else _connections.erase(connectionIterator);
+				}
+			}
+		}
+		interface->finishUnsubscribe();
+		if(!unused) return;
+		GD::out.printDebug("Debug: Closing connection to Kodi with hostname " + interface->getHostname() + ", because it is not used anymore.");
+		interface->stopListening();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+size_t KodiConnectionRegistry::size()
+{
+	std::lock_guard<std::mutex> connectionsGuard(_connectionsMutex);
+	return _connections.size();
+}
+
+std::vector<std::shared_ptr<KodiInterface>> KodiConnectionRegistry::getConnections()
+{
+	std::vector<std::shared_ptr<KodiInterface>> connections;
+	std::lock_guard<std::mutex> connectionsGuard(_connectionsMutex);
+	connections.reserve(_connections.size());
+	for(auto& connection : _connections)
+	{
+		connections.push_back(connection.second.interface);
+	}
+	return connections;
+}
+
+}
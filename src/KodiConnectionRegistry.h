@@ -0,0 +1,91 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODICONNECTIONREGISTRY_H_
+#define KODICONNECTIONREGISTRY_H_
+
+#include "KodiInterface.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Kodi
+{
+
+/**
+ * Module wide registry of the connections to Kodi, keyed by hostname and port. Peers controlling the same Kodi instance share one
+ * connection. The connection is closed when the last peer released it.
+ */
+class KodiConnectionRegistry
+{
+public:
+	KodiConnectionRegistry() = default;
+	virtual ~KodiConnectionRegistry() = default;
+
+	/**
+	 * Returns the connection to "hostname" and "port" and subscribes "subscriber" to it. The connection is created and started when
+	 * it doesn't exist yet.
+	 */
+	std::shared_ptr<KodiInterface> acquire(const std::string& hostname, int32_t port, const KodiInterface::Subscriber& subscriber);
+
+	/**
+	 * Unsubscribes "subscriberId" from "interface" and closes the connection when it was the last subscriber.
+	 */
+	void release(const std::shared_ptr<KodiInterface>& interface, uint64_t subscriberId);
+
+	size_t size();
+
+	/**
+	 * @return Returns all open connections.
+	 */
+	std::vector<std::shared_ptr<KodiInterface>> getConnections();
+private:
+	struct Connection
+	{
+		std::shared_ptr<KodiInterface> interface;
+
+		/**
+		 * Number of acquire() calls which found or created the connection, but didn't subscribe yet. release() doesn't remove the
+		 * connection while this is not "0".
+		 */
+		int32_t pendingSubscribers = 0;
+	};
+
+	std::mutex _connectionsMutex;
+	std::map<std::string, Connection> _connections;
+
+	static std::string getKey(const std::string& hostname, int32_t port);
+};
+
+}
+
+#endif
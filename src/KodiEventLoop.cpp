@@ -0,0 +1,454 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiEventLoop.h"
+#include "GD.h"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace Kodi
+{
+
+KodiEventLoop::KodiEventLoop()
+{
+	_out.init(GD::bl);
+	_out.setPrefix(GD::out.getPrefix() + "Event loop: ");
+	_timeouts.reset(new KodiTimingWheel(1024, 100, now()));
+}
+
+KodiEventLoop::~KodiEventLoop()
+{
+	try
+	{
+		stop();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+int64_t KodiEventLoop::now()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void KodiEventLoop::start(uint32_t workerCount)
+{
+	try
+	{
+		stop();
+		if(workerCount == 0) workerCount = 1;
+
+		_epollFd = epoll_create1(EPOLL_CLOEXEC);
+		if(_epollFd == -1)
+		{
+			_out.printCritical("Critical: Could not create epoll descriptor: " + std::string(strerror(errno)));
+			return;
+		}
+		_wakeUpFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if(_wakeUpFd == -1)
+		{
+			_out.printCritical("Critical: Could not create event descriptor: " + std::string(strerror(errno)));
+			close(_epollFd);
+			_epollFd = -1;
+			return;
+		}
+		struct epoll_event event{};
+		event.events = EPOLLIN;
+		event.data.u64 = 0;
+		epoll_ctl(_epollFd, EPOLL_CTL_ADD, _wakeUpFd, &event);
+
+		_stop = false;
+		_workerThreads.resize(workerCount);
+		for(auto& thread : _workerThreads)
+		{
+			GD::bl->threadManager.start(thread, true, &KodiEventLoop::work, this);
+		}
+		GD::bl->threadManager.start(_pollThread, true, &KodiEventLoop::poll, this);
+		_out.printInfo("Info: Started event loop with " + std::to_string(workerCount) + " worker threads.");
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void KodiEventLoop::stop()
+{
+	try
+	{
+		if(_stop) return;
+		_stop = true;
+		wakeUp();
+		GD::bl->threadManager.join(_pollThread);
+		{
+			std::lock_guard<std::mutex> tasksGuard(_tasksMutex);
+			_tasksConditionVariable.notify_all();
+		}
+		for(auto& thread : _workerThreads)
+		{
+			GD::bl->threadManager.join(thread);
+		}
+		_workerThreads.clear();
+
+		{
+			std::lock_guard<std::mutex> tasksGuard(_tasksMutex);
+			_tasks.clear();
+		}
+		{
+			std::lock_guard<std::mutex> timersGuard(_timersMutex);
+			_timers.clear();
+			_timersById.clear();
+			_timeouts->clear();
+		}
+
+		if(_wakeUpFd != -1) close(_wakeUpFd);
+		_wakeUpFd = -1;
+		if(_epollFd != -1) close(_epollFd);
+		_epollFd = -1;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void KodiEventLoop::wakeUp()
+{
+	if(_wakeUpFd == -1) return;
+	uint64_t value = 1;
+	if(write(_wakeUpFd, &value, sizeof(value)) == -1 && errno != EAGAIN) _out.printError("Error: Could not wake up event loop: " + std::string(strerror(errno)));
+}
+
+uint64_t KodiEventLoop::add(int32_t fileDescriptor, uint32_t events, std::function<void(uint32_t events)> callback)
+{
+	try
+	{
+		if(fileDescriptor < 0 || _epollFd == -1) return 0;
+
+		std::lock_guard<std::mutex> registrationsGuard(_registrationsMutex);
+		uint64_t registrationId = _currentRegistrationId++;
+		auto registration = std::make_shared<Registration>();
+		registration->fileDescriptor = fileDescriptor;
+		registration->callback = std::move(callback);
+
+		struct epoll_event event{};
+		event.events = events | EPOLLONESHOT;
+		event.data.u64 = registrationId;
+		if(epoll_ctl(_epollFd, EPOLL_CTL_ADD, fileDescriptor, &event) == -1)
+		{
+			_out.printError("Error: Could not add descriptor to epoll: " + std::string(strerror(errno)));
+			return 0;
+		}
+		_registrations.emplace(registrationId, registration);
+		return registrationId;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return 0;
+}
+
+bool KodiEventLoop::rearm(uint64_t registrationId, uint32_t events)
+{
+	try
+	{
+		std::lock_guard<std::mutex> registrationsGuard(_registrationsMutex);
+		auto registrationIterator = _registrations.find(registrationId);
+		if(registrationIterator == _registrations.end() || _epollFd == -1) return false;
+
+		struct epoll_event event{};
+		event.events = events | EPOLLONESHOT;
+		event.data.u64 = registrationId;
+		if(epoll_ctl(_epollFd, EPOLL_CTL_MOD, registrationIterator->second->fileDescriptor, &event) == -1)
+		{
+			_out.printError("Error: Could not rearm descriptor: " + std::string(strerror(errno)));
+			return false;
+		}
+		return true;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return false;
+}
+
+void KodiEventLoop::remove(uint64_t registrationId, bool wait)
+{
+	try
+	{
+		if(registrationId == 0) return;
+		std::unique_lock<std::mutex> registrationsGuard(_registrationsMutex);
+		auto registrationIterator = _registrations.find(registrationId);
+		if(registrationIterator == _registrations.end()) return;
+		PRegistration registration = registrationIterator->second;
+		_registrations.erase(registrationIterator);
+		registration->removed = true;
+		if(_epollFd != -1) epoll_ctl(_epollFd, EPOLL_CTL_DEL, registration->fileDescriptor, nullptr);
+		if(wait) _registrationsConditionVariable.wait(registrationsGuard, [&] { return registration->running == 0; });
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+uint64_t KodiEventLoop::addTimer(int64_t delay, std::function<void()> callback)
+{
+	try
+	{
+		uint64_t timerId = 0;
+		bool first = false;
+		{
+			std::lock_guard<std::mutex> timersGuard(_timersMutex);
+			timerId = _currentTimerId++;
+			Timer timer;
+			timer.id = timerId;
+			timer.callback = std::move(callback);
+			int64_t dueTime = now() + (delay < 0 ? 0 : delay);
+			auto timerIterator = _timers.emplace(dueTime, std::move(timer));
+			_timersById.emplace(timerId, timerIterator);
+			first = (timerIterator == _timers.begin());
+		}
+		//Let the poll thread recalculate its timeout
+		if(first) wakeUp();
+		return timerId;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return 0;
+}
+
+void KodiEventLoop::removeTimer(uint64_t timerId)
+{
+	try
+	{
+		if(timerId == 0) return;
+		std::lock_guard<std::mutex> timersGuard(_timersMutex);
+		auto timerIterator = _timersById.find(timerId);
+		if(timerIterator == _timersById.end()) return;
+		_timers.erase(timerIterator->second);
+		_timersById.erase(timerIterator);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+uint64_t KodiEventLoop::addTimeout(int64_t delay, std::function<void()> callback)
+{
+	try
+	{
+		uint64_t timeoutId = 0;
+		bool first = false;
+		{
+			std::lock_guard<std::mutex> timersGuard(_timersMutex);
+			first = (_timeouts->size() == 0);
+			timeoutId = _timeouts->add(delay, std::move(callback), now());
+		}
+		//The poll thread only wakes up for ticks while timeouts are pending.
+		if(first) wakeUp();
+		return timeoutId;
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return 0;
+}
+
+void KodiEventLoop::removeTimeout(uint64_t timeoutId)
+{
+	try
+	{
+		if(timeoutId == 0) return;
+		std::lock_guard<std::mutex> timersGuard(_timersMutex);
+		_timeouts->remove(timeoutId);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void KodiEventLoop::post(std::function<void()> task)
+{
+	try
+	{
+		if(_stop) return;
+		{
+			std::lock_guard<std::mutex> tasksGuard(_tasksMutex);
+			_tasks.emplace_back(std::move(task));
+		}
+		_tasksConditionVariable.notify_one();
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+int32_t KodiEventLoop::getPollTimeout()
+{
+	std::lock_guard<std::mutex> timersGuard(_timersMutex);
+	int64_t dueTime = _timers.empty() ? -1 : _timers.begin()->first;
+	int64_t nextTick = _timeouts->nextTick();
+	if(nextTick != -1 && (dueTime == -1 || nextTick < dueTime)) dueTime = nextTick;
+	if(dueTime == -1) return -1;
+	int64_t timeout = dueTime - now();
+	if(timeout < 0) return 0;
+	return timeout > 60000 ? 60000 : (int32_t)timeout;
+}
+
+void KodiEventLoop::fireTimers()
+{
+	try
+	{
+		std::vector<std::function<void()>> dueCallbacks;
+		{
+			std::lock_guard<std::mutex> timersGuard(_timersMutex);
+			int64_t time = now();
+			while(!_timers.empty() && _timers.begin()->first <= time)
+			{
+				dueCallbacks.emplace_back(std::move(_timers.begin()->second.callback));
+				_timersById.erase(_timers.begin()->second.id);
+				_timers.erase(_timers.begin());
+			}
+			_timeouts->advance(time, dueCallbacks);
+		}
+		for(auto& callback : dueCallbacks)
+		{
+			post(std::move(callback));
+		}
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void KodiEventLoop::execute(uint64_t registrationId, uint32_t events)
+{
+	PRegistration registration;
+	{
+		std::lock_guard<std::mutex> registrationsGuard(_registrationsMutex);
+		auto registrationIterator = _registrations.find(registrationId);
+		if(registrationIterator == _registrations.end()) return;
+		registration = registrationIterator->second;
+		registration->running++;
+	}
+
+	try
+	{
+		if(!registration->removed) registration->callback(events);
+	}
+	catch(const std::exception& ex)
+	{
+		_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+
+	{
+		std::lock_guard<std::mutex> registrationsGuard(_registrationsMutex);
+		registration->running--;
+	}
+	_registrationsConditionVariable.notify_all();
+}
+
+void KodiEventLoop::poll()
+{
+	const int32_t maxEvents = 64;
+	std::vector<struct epoll_event> events(maxEvents);
+	while(!_stop)
+	{
+		try
+		{
+			int32_t eventCount = epoll_wait(_epollFd, events.data(), maxEvents, getPollTimeout());
+			if(_stop) return;
+			if(eventCount == -1)
+			{
+				if(errno == EINTR) continue;
+				_out.printError("Error: epoll_wait failed: " + std::string(strerror(errno)));
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				continue;
+			}
+
+			for(int32_t i = 0; i < eventCount; i++)
+			{
+				uint64_t registrationId = events[i].data.u64;
+				if(registrationId == 0)
+				{
+					uint64_t value = 0;
+					if(read(_wakeUpFd, &value, sizeof(value)) == -1 && errno != EAGAIN) _out.printError("Error: Could not read from event descriptor: " + std::string(strerror(errno)));
+					continue;
+				}
+				uint32_t eventFlags = events[i].events;
+				post([this, registrationId, eventFlags]() { execute(registrationId, eventFlags); });
+			}
+
+			fireTimers();
+		}
+		catch(const std::exception& ex)
+		{
+			_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+		}
+	}
+}
+
+void KodiEventLoop::work()
+{
+	while(!_stop)
+	{
+		try
+		{
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> tasksGuard(_tasksMutex);
+				_tasksConditionVariable.wait(tasksGuard, [&] { return !_tasks.empty() || _stop; });
+				if(_stop) return;
+				task = std::move(_tasks.front());
+				_tasks.pop_front();
+			}
+			if(task) task();
+		}
+		catch(const std::exception& ex)
+		{
+			_out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+		}
+	}
+}
+
+}
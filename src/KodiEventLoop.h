@@ -0,0 +1,160 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODIEVENTLOOP_H_
+#define KODIEVENTLOOP_H_
+
+#include <homegear-base/BaseLib.h>
+#include "KodiTimingWheel.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Kodi
+{
+
+/**
+ * Module wide reactor. One thread waits on epoll for all registered descriptors and a fixed pool of worker threads executes
+ * the callbacks, so the number of threads does not depend on the number of peers.
+ */
+class KodiEventLoop
+{
+public:
+	KodiEventLoop();
+	virtual ~KodiEventLoop();
+
+	void start(uint32_t workerCount);
+	void stop();
+
+	/**
+	 * Registers a file descriptor. The descriptor is registered with EPOLLONESHOT, so the callback is never executed by two
+	 * workers at the same time. Call rearm() when the callback is ready for more events.
+	 *
+	 * @param fileDescriptor The descriptor to watch.
+	 * @param events The epoll events to wait for (EPOLLIN, EPOLLOUT, ...).
+	 * @param callback Executed on one of the worker threads with the events that occurred.
+	 * @return Returns a registration id greater than 0 or 0 on error.
+	 */
+	uint64_t add(int32_t fileDescriptor, uint32_t events, std::function<void(uint32_t events)> callback);
+
+	/**
+	 * Rearms a registration after its callback was executed.
+	 */
+	bool rearm(uint64_t registrationId, uint32_t events);
+
+	/**
+	 * Removes a registration. The descriptor is not closed.
+	 *
+	 * @param wait When true, the method waits until a running callback of this registration finished. Must be false when
+	 * called from within the registration's own callback.
+	 */
+	void remove(uint64_t registrationId, bool wait);
+
+	/**
+	 * Executes "callback" once on a worker thread after "delay" milliseconds.
+	 *
+	 * @return Returns the timer id needed to remove the timer.
+	 */
+	uint64_t addTimer(int64_t delay, std::function<void()> callback);
+	void removeTimer(uint64_t timerId);
+
+	/**
+	 * Like addTimer(), but with a resolution of 100 ms. Meant for timeouts which are usually removed before they expire, like
+	 * request timeouts. Adding and removing are O(1).
+	 *
+	 * @return Returns the timeout id needed to remove the timeout.
+	 */
+	uint64_t addTimeout(int64_t delay, std::function<void()> callback);
+	void removeTimeout(uint64_t timeoutId);
+
+	/**
+	 * Executes "task" on one of the worker threads.
+	 */
+	void post(std::function<void()> task);
+
+	uint32_t workerCount() { return _workerThreads.size(); }
+private:
+	struct Registration
+	{
+		int32_t fileDescriptor = -1;
+		std::function<void(uint32_t events)> callback;
+		bool removed = false;
+		int32_t running = 0;
+	};
+	typedef std::shared_ptr<Registration> PRegistration;
+
+	struct Timer
+	{
+		uint64_t id = 0;
+		std::function<void()> callback;
+	};
+
+	BaseLib::Output _out;
+	int32_t _epollFd = -1;
+	int32_t _wakeUpFd = -1;
+	std::atomic_bool _stop{true};
+
+	std::thread _pollThread;
+	std::vector<std::thread> _workerThreads;
+
+	std::mutex _registrationsMutex;
+	std::condition_variable _registrationsConditionVariable;
+	uint64_t _currentRegistrationId = 1;
+	std::unordered_map<uint64_t, PRegistration> _registrations;
+
+	std::mutex _timersMutex;
+	uint64_t _currentTimerId = 1;
+	std::multimap<int64_t, Timer> _timers;
+	std::unordered_map<uint64_t, std::multimap<int64_t, Timer>::iterator> _timersById;
+	std::unique_ptr<KodiTimingWheel> _timeouts;
+
+	std::mutex _tasksMutex;
+	std::condition_variable _tasksConditionVariable;
+	std::deque<std::function<void()>> _tasks;
+
+	static int64_t now();
+	void wakeUp();
+	int32_t getPollTimeout();
+	void fireTimers();
+	void execute(uint64_t registrationId, uint32_t events);
+	void poll();
+	void work();
+};
+
+}
+
+#endif
@@ -0,0 +1,118 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiHistogram.h"
+
+#include <algorithm>
+
+namespace Kodi
+{
+
+KodiHistogram::KodiHistogram(uint32_t windowSize)
+{
+	_windowSize = windowSize == 0 ? 1 : windowSize;
+	_samples.reserve(_windowSize);
+}
+
+void KodiHistogram::add(int64_t value)
+{
+	std::lock_guard<std::mutex> histogramGuard(_mutex);
+	if(_samples.size() < _windowSize) _samples.push_back(value);
+	else _samples[_next] = value;
+	_next = (_next + 1) % _windowSize;
+}
+
+void KodiHistogram::clear()
+{
+	std::lock_guard<std::mutex> histogramGuard(_mutex);
+	_samples.clear();
+	_next = 0;
+}
+
+uint32_t KodiHistogram::count()
+{
+	std::lock_guard<std::mutex> histogramGuard(_mutex);
+	return _samples.size();
+}
+
+int64_t KodiHistogram::percentile(std::vector<int64_t>& sortedSamples, double percentile)
+{
+	if(sortedSamples.empty()) return 0;
+	if(percentile < 0) percentile = 0;
+	else if(percentile > 100) percentile = 100;
+	size_t index = (size_t)((percentile / 100.0) * (sortedSamples.size() - 1) + 0.5);
+	return sortedSamples.at(index);
+}
+
+int64_t KodiHistogram::percentile(double percentile)
+{
+	std::vector<int64_t> samples;
+	{
+		std::lock_guard<std::mutex> histogramGuard(_mutex);
+		samples = _samples;
+	}
+	std::sort(samples.begin(), samples.end());
+	return KodiHistogram::percentile(samples, percentile);
+}
+
+BaseLib::PVariable KodiHistogram::toVariable()
+{
+	static const std::vector<int64_t> bucketLimits{1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000};
+
+	std::vector<int64_t> samples;
+	{
+		std::lock_guard<std::mutex> histogramGuard(_mutex);
+		samples = _samples;
+	}
+	std::sort(samples.begin(), samples.end());
+
+	auto histogram = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+	histogram->structValue->emplace("count", std::make_shared<BaseLib::Variable>((int32_t)samples.size()));
+	histogram->structValue->emplace("min", std::make_shared<BaseLib::Variable>(samples.empty() ? (int64_t)0 : samples.front()));
+	histogram->structValue->emplace("max", std::make_shared<BaseLib::Variable>(samples.empty() ? (int64_t)0 : samples.back()));
+	histogram->structValue->emplace("median", std::make_shared<BaseLib::Variable>(percentile(samples, 50)));
+	histogram->structValue->emplace("p95", std::make_shared<BaseLib::Variable>(percentile(samples, 95)));
+
+	auto buckets = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+	auto sample = samples.begin();
+	for(auto limit : bucketLimits)
+	{
+		int32_t count = 0;
+		for(; sample != samples.end() && *sample <= limit; ++sample)
+		{
+			count++;
+		}
+		buckets->structValue->emplace("<=" + std::to_string(limit), std::make_shared<BaseLib::Variable>(count));
+	}
+	buckets->structValue->emplace(">" + std::to_string(bucketLimits.back()), std::make_shared<BaseLib::Variable>((int32_t)(samples.end() - sample)));
+	histogram->structValue->emplace("buckets", buckets);
+	return histogram;
+}
+
+}
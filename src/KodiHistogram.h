@@ -0,0 +1,85 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODIHISTOGRAM_H_
+#define KODIHISTOGRAM_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace Kodi
+{
+
+/**
+ * Thread safe histogram over the last samples of a value, e. g. round trip times in milliseconds. The samples are kept in a
+ * fixed ring, so memory usage is constant and old samples drop out of the statistics.
+ */
+class KodiHistogram
+{
+public:
+	/**
+	 * @param windowSize The number of samples to keep.
+	 */
+	explicit KodiHistogram(uint32_t windowSize = 64);
+	virtual ~KodiHistogram() = default;
+
+	void add(int64_t value);
+	void clear();
+
+	/**
+	 * @return Returns the number of samples in the window.
+	 */
+	uint32_t count();
+
+	/**
+	 * @param percentile A value between 0 and 100.
+	 * @return Returns the percentile of the samples in the window or 0 when there are no samples.
+	 */
+	int64_t percentile(double percentile);
+
+	/**
+	 * @return Returns a struct with the number of samples, minimum, maximum, median, 95th percentile and the samples per bucket.
+	 * The bucket "<=N" contains all samples less or equal N and greater than the previous bucket's limit.
+	 */
+	BaseLib::PVariable toVariable();
+private:
+	std::mutex _mutex;
+	std::vector<int64_t> _samples;
+	uint32_t _windowSize = 64;
+	uint32_t _next = 0;
+
+	static int64_t percentile(std::vector<int64_t>& sortedSamples, double percentile);
+};
+
+}
+
+#endif
@@ -30,38 +30,304 @@
 #include "GD.h"
 #include "KodiInterface.h"
 
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sstream>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
 namespace Kodi {
 
+namespace {
+int64_t steadyTime() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t elapsedMicroseconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+}
+
 KodiInterface::KodiInterface() {
   _out.init(GD::bl);
   _out.setPrefix(GD::out.getPrefix() + "Kodi interface: ");
 
   signal(SIGPIPE, SIG_IGN);
 
-  C1Net::TcpSocketInfo tcp_socket_info;
-  auto dummy_socket = std::make_shared<C1Net::Socket>(-1);
-  _socket = std::make_unique<C1Net::TcpSocket>(tcp_socket_info, dummy_socket);
-
   _jsonEncoder.reset(new BaseLib::Rpc::JsonEncoder(GD::bl));
-  _jsonDecoder.reset(new BaseLib::Rpc::JsonDecoder(GD::bl));
+
+  _maxInFlightRequests = GD::family->getIntegerSetting("maxinflightrequests", 8);
+  if (_maxInFlightRequests < 1) _maxInFlightRequests = 1;
+  _requestTimeout = GD::family->getIntegerSetting("requesttimeout", 10000);
+  if (_requestTimeout < 100) _requestTimeout = 10000;
+  int32_t maxQueuedRequests = GD::family->getIntegerSetting("outboundqueuesize", 100);
+  _maxQueuedRequests = maxQueuedRequests < 0 ? 0 : maxQueuedRequests;
+  _batchWindow = GD::family->getIntegerSetting("batchwindow", 0);
+  int32_t maxFrameSize = GD::family->getIntegerSetting("maxframesize", 1000000);
+  if (maxFrameSize < 4096) maxFrameSize = 1000000;
+  _framer.reset(new KodiJsonFramer(maxFrameSize));
+  int32_t notificationQueueSize = GD::family->getIntegerSetting("notificationqueuesize", 1024);
+  if (notificationQueueSize < 16) notificationQueueSize = 1024;
+  _notifications.reset(new KodiSpscQueue<Notification>(notificationQueueSize));
+  _framer->setStreamCallbacks([this](int64_t requestId) { return isStreamed(requestId); },
+                              [this](int64_t requestId, const char *data, size_t size) { processElement(requestId, data, size); },
+                              [this](int64_t requestId, bool complete) { streamFinished(requestId, complete); });
 }
 
 KodiInterface::~KodiInterface() {
   try {
-    _stopCallbackThread = true;
-    GD::bl->threadManager.join(_listenThread);
+    //The event loop only holds weak references, so no callback of this object can be running anymore.
+    _listening = false;
+    closeSocket(false);
+    GD::bl->threadManager.join(_resolverThread);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void KodiInterface::subscribe(const Subscriber &subscriber) {
+  try {
+    {
+      std::lock_guard<std::mutex> subscribersGuard(_subscribersMutex);
+      auto subscribers = _subscribers ? std::make_shared<std::vector<Subscriber>>(*_subscribers) : std::make_shared<std::vector<Subscriber>>();
+      subscribers->push_back(subscriber);
+      _subscribers = subscribers;
+    }
+    bool connected = false;
+    {
+      std::lock_guard<std::mutex> socketGuard(_socketMutex);
+      connected = (_state == ConnectionState::connected);
+    }
+    if (updateFilter() && connected) configureNotifications();
+    if (subscriber.connected) subscriber.connected(connected);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void KodiInterface::unsubscribe(uint64_t subscriberId) {
+  removeSubscriber(subscriberId);
+  finishUnsubscribe();
+}
+
+size_t KodiInterface::removeSubscriber(uint64_t subscriberId) {
+  try {
+    std::lock_guard<std::mutex> subscribersGuard(_subscribersMutex);
+    if (!_subscribers) return 0;
+    auto subscribers = std::make_shared<std::vector<Subscriber>>();
+    subscribers->reserve(_subscribers->size());
+    for (auto &subscriber : *_subscribers) {
+      if (subscriber.id != subscriberId) subscribers->push_back(subscriber);
+    }
+    _subscribers = subscribers;
+    return subscribers->size();
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return 0;
+}
+
+void KodiInterface::finishUnsubscribe() {
+  try {
+    {
+      std::unique_lock<std::mutex> subscribersGuard(_subscribersMutex);
+      //Dispatches started before might still use the removed subscriber.
+      _subscribersConditionVariable.wait(subscribersGuard, [&] { return _runningDispatches == 0; });
+    }
+    if (updateFilter() && getConnectionState() == ConnectionState::connected) configureNotifications();
   }
   catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
   }
 }
 
-void KodiInterface::setConnectedCallback(std::function<void(bool connected)> callback) {
-  _connectedCallback = callback;
+size_t KodiInterface::subscriberCount() {
+  std::lock_guard<std::mutex> subscribersGuard(_subscribersMutex);
+  return _subscribers ? _subscribers->size() : 0;
+}
+
+std::shared_ptr<const std::vector<KodiInterface::Subscriber>> KodiInterface::enterDispatch() {
+  std::lock_guard<std::mutex> subscribersGuard(_subscribersMutex);
+  _runningDispatches++;
+  return _subscribers;
+}
+
+void KodiInterface::leaveDispatch() {
+  {
+    std::lock_guard<std::mutex> subscribersGuard(_subscribersMutex);
+    _runningDispatches--;
+  }
+  _subscribersConditionVariable.notify_all();
+}
+
+void KodiInterface::notifyConnected(bool connected) {
+  auto subscribers = enterDispatch();
+  if (subscribers) {
+    for (auto &subscriber : *subscribers) {
+      if (subscriber.connected) subscriber.connected(connected);
+    }
+  }
+  leaveDispatch();
+}
+
+void KodiInterface::notifyReconnectScheduled(uint32_t attempts, int64_t delay) {
+  auto subscribers = enterDispatch();
+  if (subscribers) {
+    for (auto &subscriber : *subscribers) {
+      if (subscriber.reconnectScheduled) subscriber.reconnectScheduled(attempts, delay);
+    }
+  }
+  leaveDispatch();
+}
+
+void KodiInterface::notifyRoundTripMeasured(int64_t roundTripTime) {
+  auto subscribers = enterDispatch();
+  if (subscribers) {
+    for (auto &subscriber : *subscribers) {
+      if (subscriber.roundTripMeasured) subscriber.roundTripMeasured(roundTripTime);
+    }
+  }
+  leaveDispatch();
+}
+
+void KodiInterface::notifyPacketReceived(KodiPacket &packet) {
+  auto subscribers = enterDispatch();
+  if (subscribers) {
+    //The packet caches its converted parameters, so the message is only converted once for all subscribers.
+    for (auto &subscriber : *subscribers) {
+      if (subscriber.packetReceived) subscriber.packetReceived(packet);
+    }
+  }
+  leaveDispatch();
+}
+
+bool KodiInterface::updateFilter() {
+  std::set<std::string> namespaces;
+  std::vector<std::string> methods;
+  {
+    std::lock_guard<std::mutex> subscribersGuard(_subscribersMutex);
+    if (_subscribers) {
+      //A subscriber without restrictions disables the restriction for the whole connection.
+      bool allNamespaces = false;
+      bool allMethods = false;
+      for (auto &subscriber : *_subscribers) {
+        if (subscriber.namespaces.empty()) allNamespaces = true;
+        else namespaces.insert(subscriber.namespaces.begin(), subscriber.namespaces.end());
+        if (subscriber.methods.empty()) allMethods = true;
+        else methods.insert(methods.end(), subscriber.methods.begin(), subscriber.methods.end());
+      }
+      if (allNamespaces) namespaces.clear();
+      if (allMethods) methods.clear();
+      std::sort(methods.begin(), methods.end());
+      methods.erase(std::unique(methods.begin(), methods.end()), methods.end());
+    }
+  }
+
+  KodiMethodSet mappedMethods(methods);
+  {
+    std::lock_guard<std::mutex> filterGuard(_filterMutex);
+    _mappedMethods = std::move(mappedMethods);
+  }
+
+  std::lock_guard<std::mutex> socketGuard(_socketMutex);
+  if (namespaces == _notificationNamespaces) return false;
+  _notificationNamespaces = std::move(namespaces);
+  return true;
+}
+
+void KodiInterface::setReconnectDelays(int64_t minDelay, int64_t maxDelay) {
+  if (minDelay < 100) minDelay = 100;
+  if (maxDelay < minDelay) maxDelay = minDelay;
+  std::lock_guard<std::mutex> socketGuard(_socketMutex);
+  _reconnectMinDelay = minDelay;
+  _reconnectMaxDelay = maxDelay;
+}
+
+KodiInterface::ConnectionState KodiInterface::getConnectionState() {
+  std::lock_guard<std::mutex> socketGuard(_socketMutex);
+  return _state;
+}
+
+void KodiInterface::setHeartbeat(int64_t interval, int32_t maxMisses) {
+  if (interval < 0) interval = 0;
+  else if (interval > 0 && interval < 1000) interval = 1000;
+  if (maxMisses < 1) maxMisses = 1;
+  std::lock_guard<std::mutex> socketGuard(_socketMutex);
+  bool wasEnabled = _heartbeatInterval > 0;
+  _heartbeatInterval = interval;
+  _heartbeatMaxMisses = maxMisses;
+  if (_state != ConnectionState::connected) return;
+  if (interval == 0) {
+    if (GD::eventLoop) GD::eventLoop->removeTimer(_heartbeatTimerId);
+    _heartbeatTimerId = 0;
+  } else if (!wasEnabled) scheduleHeartbeat(interval);
+}
+
+std::map<std::string, uint64_t> KodiInterface::getDroppedNotifications() {
+  std::lock_guard<std::mutex> filterGuard(_filterMutex);
+  return std::map<std::string, uint64_t>(_droppedNotifications.begin(), _droppedNotifications.end());
+}
+
+BaseLib::PVariable KodiInterface::getMetrics() {
+  auto metrics = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+  try {
+    uint64_t droppedNotifications = 0;
+    {
+      std::lock_guard<std::mutex> filterGuard(_filterMutex);
+      for (auto &droppedNotification : _droppedNotifications) {
+        droppedNotifications += droppedNotification.second;
+      }
+    }
+    auto addCounter = [&](const std::string &name, uint64_t value) {
+      metrics->structValue->emplace(name, std::make_shared<BaseLib::Variable>((int64_t)value));
+    };
+    addCounter("bytesReceived", _bytesReceived);
+    addCounter("bytesSent", _bytesSent);
+    addCounter("framesReceived", _framesReceived);
+    addCounter("framesSent", _framesSent);
+    addCounter("timeouts", _timeouts);
+    addCounter("reconnects", _reconnects);
+    addCounter("queuedRequests", getQueuedRequestCount());
+    addCounter("inFlightRequests", getInFlightRequestCount());
+    addCounter("droppedRequests", _droppedRequests);
+    addCounter("skippedFrames", _skippedFrames);
+    addCounter("unmatchedResponses", _unmatchedResponses);
+    addCounter("droppedNotifications", droppedNotifications);
+    addCounter("overflowedNotifications", _overflowedNotifications);
+    metrics->structValue->emplace("decodeTimes", _decodeTimes.toVariable());
+    metrics->structValue->emplace("requestTimes", _requestTimes.toVariable());
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return metrics;
 }
 
-void KodiInterface::setPacketReceivedCallback(std::function<void(std::shared_ptr < KodiPacket > packet)> callback) {
-  _packetReceivedCallback = callback;
+std::string KodiInterface::printMetrics(const BaseLib::PVariable &metrics) {
+  std::ostringstream stream;
+  if (!metrics) return stream.str();
+  for (auto &metric : *metrics->structValue) {
+    if (metric.second->type != BaseLib::VariableType::tStruct) {
+      stream << metric.first << ": " << metric.second->integerValue64 << std::endl;
+      continue;
+    }
+    stream << metric.first << ":";
+    for (const char *key : {"count", "min", "median", "p95", "max"}) {
+      auto valueIterator = metric.second->structValue->find(key);
+      if (valueIterator != metric.second->structValue->end()) stream << " " << key << " " << valueIterator->second->integerValue64;
+    }
+    stream << std::endl;
+  }
+  return stream.str();
 }
 
 std::string KodiInterface::getHostname() { return _hostname; }
@@ -87,228 +353,1237 @@ void KodiInterface::setPort(int32_t port) {
   }
 }
 
-void KodiInterface::getResponse(BaseLib::PVariable &request, BaseLib::PVariable &response) {
+bool KodiInterface::enterCallback() {
+  std::lock_guard<std::mutex> callbacksGuard(_callbacksMutex);
+  if (!_listening) return false;
+  _runningCallbacks++;
+  return true;
+}
+
+void KodiInterface::leaveCallback() {
+  {
+    std::lock_guard<std::mutex> callbacksGuard(_callbacksMutex);
+    _runningCallbacks--;
+  }
+  _callbacksConditionVariable.notify_all();
+}
+
+bool KodiInterface::sendData(const std::string &data) {
   try {
-    if (_stopped || request->type != BaseLib::VariableType::tStruct) return;
+    std::lock_guard<std::mutex> socketGuard(_socketMutex);
+    if (_socketDescriptor == -1 || _state != ConnectionState::connected) {
+      _out.printError("Error sending packet to Kodi: Not connected.");
+      return false;
+    }
 
-    uint32_t requestId = _currentRequestId++;
-    request->structValue->insert(BaseLib::StructElement("id", BaseLib::PVariable(new Variable(requestId))));
+    //Data must not overtake data which is still waiting in the send buffer.
+    size_t totalBytesWritten = 0;
+    while (_sendBuffer.empty() && totalBytesWritten < data.size()) {
+      ssize_t bytesWritten = ::send(_socketDescriptor, data.data() + totalBytesWritten, data.size() - totalBytesWritten, MSG_NOSIGNAL);
+      if (bytesWritten == -1) {
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        _out.printError("Error sending packet to Kodi: " + std::string(strerror(errno)));
+        return false;
+      }
+      totalBytesWritten += bytesWritten;
+      _bytesSent += bytesWritten;
+    }
 
-    std::string json;
+    if (totalBytesWritten < data.size()) {
+      const size_t maxSendBufferSize = 4 * 1024 * 1024;
+      if (_sendBuffer.size() + (data.size() - totalBytesWritten) > maxSendBufferSize) {
+        _out.printError("Error sending packet to Kodi: Send buffer is full.");
+        return false;
+      }
+      bool wasEmpty = _sendBuffer.empty();
+      _sendBuffer.append(data, totalBytesWritten, std::string::npos);
+      //While socketEvent() runs, the descriptor is disarmed and socketEvent() rearms it with EPOLLOUT itself. Rearming here would
+      //allow a second worker to enter socketEvent().
+      if (wasEmpty && !_socketEventRunning && _registrationId != 0) GD::eventLoop->rearm(_registrationId, socketEvents());
+    }
+
+    if (_capturing) capture(KodiCapture::Direction::outbound, data.data(), data.size());
+    _framesSent++;
+    return true;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+bool KodiInterface::flushSendBuffer() {
+  size_t totalBytesWritten = 0;
+  while (totalBytesWritten < _sendBuffer.size()) {
+    ssize_t bytesWritten = ::send(_socketDescriptor, _sendBuffer.data() + totalBytesWritten, _sendBuffer.size() - totalBytesWritten, MSG_NOSIGNAL);
+    if (bytesWritten == -1) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+      _out.printError("Error sending packet to Kodi: " + std::string(strerror(errno)));
+      _sendBuffer.clear();
+      return false;
+    }
+    totalBytesWritten += bytesWritten;
+    _bytesSent += bytesWritten;
+  }
+  _sendBuffer.erase(0, totalBytesWritten);
+  if (_sendBuffer.empty() && _sendBuffer.capacity() > 65536) _sendBuffer.shrink_to_fit();
+  return true;
+}
+
+uint32_t KodiInterface::socketEvents() {
+  return _sendBuffer.empty() ? (uint32_t)(EPOLLIN | EPOLLRDHUP) : (uint32_t)(EPOLLIN | EPOLLRDHUP | EPOLLOUT);
+}
+
+size_t KodiInterface::getQueuedRequestCount() {
+  std::lock_guard<std::mutex> requestsGuard(_requestsMutex);
+  return _queuedRequests.size();
+}
+
+int32_t KodiInterface::getInFlightRequestCount() {
+  std::lock_guard<std::mutex> requestsGuard(_requestsMutex);
+  return _inFlightRequests;
+}
+
+bool KodiInterface::serializeRequest(BaseLib::PVariable &request, std::string &json) {
+  try {
+    if (!request || request->type != BaseLib::VariableType::tStruct) return false;
     _jsonEncoder->encode(request, json);
-    if (json.empty()) return;
+    if (json.size() < 2 || json.back() != '}') return false;
+    //Leave the object open for the id
+    json.pop_back();
+    if (json.size() > 1) json.push_back(',');
+    json.append("\"id\":");
+    return true;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+bool KodiInterface::sendRequest(BaseLib::PVariable &request, std::function<void(const BaseLib::PVariable &response)> callback, int32_t timeout) {
+  std::string json;
+  if (!serializeRequest(request, json)) return false;
+  return sendRequest(std::move(json), std::move(callback), timeout);
+}
+
+bool KodiInterface::sendRequest(std::string &&request, std::function<void(const BaseLib::PVariable &response)> callback, int32_t timeout) {
+  auto queuedRequest = std::make_shared<Request>();
+  queuedRequest->callback = std::move(callback);
+  queuedRequest->json = std::move(request);
+  return submitRequest(queuedRequest, timeout);
+}
+
+bool KodiInterface::sendStreamingRequest(BaseLib::PVariable &request, std::function<void(const KodiJsonDocument &document, uint32_t element)> elementCallback, std::function<void(const BaseLib::PVariable &response)> callback, int32_t timeout) {
+  auto queuedRequest = std::make_shared<Request>();
+  if (!serializeRequest(request, queuedRequest->json)) return false;
+  queuedRequest->callback = std::move(callback);
+  queuedRequest->elementCallback = std::move(elementCallback);
+  return submitRequest(queuedRequest, timeout);
+}
+
+bool KodiInterface::submitRequest(std::shared_ptr<Request> &queuedRequest, int32_t timeout) {
+  try {
+    if (_stopped || !GD::eventLoop) return false;
+    if (timeout < 0) timeout = _requestTimeout;
+
+    queuedRequest->id = _currentRequestId++;
+    char idBuffer[16];
+    auto idEnd = std::to_chars(idBuffer, idBuffer + sizeof(idBuffer), queuedRequest->id).ptr;
+    queuedRequest->json.append(idBuffer, idEnd - idBuffer);
+    queuedRequest->json.push_back('}');
+
+    {
+      std::lock_guard<std::mutex> requestsGuard(_requestsMutex);
+      if (_inFlightRequests < _maxInFlightRequests) {
+        _inFlightRequests++;
+        queuedRequest->sent = true;
+      } else if (_queuedRequests.size() < _maxQueuedRequests) _queuedRequests.push_back(queuedRequest);
+      else {
+        _droppedRequests++;
+        _out.printError("Error: Outbound queue is full. Dropping packet: " + queuedRequest->json);
+        return false;
+      }
+
+      std::weak_ptr<KodiInterface> weakInterface = shared_from_this();
+      uint32_t requestId = queuedRequest->id;
+      queuedRequest->timeoutId = GD::eventLoop->addTimeout(timeout, [weakInterface, requestId]() {
+        auto interface = weakInterface.lock();
+        if (interface) interface->requestTimeout(requestId);
+      });
+      _requests[requestId] = queuedRequest;
+    }
+
+    if (queuedRequest->sent) transmit(queuedRequest);
+    return true;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+void KodiInterface::transmit(std::shared_ptr<Request> &request) {
+  try {
+    request->sendTime = steadyTime();
+    if (!queueRequest(request->id, request->json)) finishRequest(request->id, BaseLib::PVariable());
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void KodiInterface::requestTimeout(uint32_t requestId) {
+  try {
+    std::string json;
+    {
+      std::lock_guard<std::mutex> requestsGuard(_requestsMutex);
+      auto requestIterator = _requests.find(requestId);
+      if (requestIterator == _requests.end()) return;
+      requestIterator->second->timeoutId = 0;
+      json = requestIterator->second->json;
+    }
+    _timeouts++;
+    _out.printError("Error: No response received to packet: " + json);
+    finishRequest(requestId, BaseLib::PVariable());
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+bool KodiInterface::getResponse(std::string &&request, BaseLib::PVariable &response, int32_t timeout) {
+  try {
+    if (timeout < 0) timeout = _requestTimeout;
+
+    struct Result {
+      std::mutex mutex;
+      std::condition_variable conditionVariable;
+      bool ready = false;
+      BaseLib::PVariable response;
+    };
+    auto result = std::make_shared<Result>();
 
-    std::lock_guard<std::mutex> getResponseGuard(_getResponseMutex);
-    std::shared_ptr<Request> request(new Request());
-    _requestsMutex.lock();
-    _requests[requestId] = request;
-    _requestsMutex.unlock();
-    std::unique_lock<std::mutex> lock(request->mutex);
+    if (!sendRequest(std::move(request), [result](const BaseLib::PVariable &response) {
+      {
+        std::lock_guard<std::mutex> resultGuard(result->mutex);
+        result->response = response;
+        result->ready = true;
+      }
+      result->conditionVariable.notify_one();
+    }, timeout)) {
+      return false;
+    }
+
+    //The request's timer finishes the request. The additional second only protects against a stopped event loop.
+    std::unique_lock<std::mutex> resultGuard(result->mutex);
+    result->conditionVariable.wait_for(resultGuard, std::chrono::milliseconds(timeout + 1000), [&] { return result->ready; });
+    response = result->response;
+    return true;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
 
-    try {
+bool KodiInterface::queueRequest(uint32_t requestId, std::string &json) {
+  try {
+    if (_batchWindow <= 0 || !GD::eventLoop) {
       _out.printInfo("Info: Sending packet " + json);
-      _socket->Send((uint8_t *)json.data(), json.size());
+      return sendData(json);
     }
-    catch (const BaseLib::Exception &ex) {
-      _out.printError("Error sending packet to Kodi: " + std::string(ex.what()));
-      return;
+
+    std::lock_guard<std::mutex> batchGuard(_batchMutex);
+    _batch.emplace_back(requestId, std::move(json));
+    if (_batch.size() == 1) {
+      std::weak_ptr<KodiInterface> weakInterface = shared_from_this();
+      _batchTimerId = GD::eventLoop->addTimer(_batchWindow, [weakInterface]() {
+        auto interface = weakInterface.lock();
+        if (!interface) return;
+        interface->flushBatch();
+      });
+    }
+    return true;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+void KodiInterface::flushBatch() {
+  try {
+    std::vector<std::pair<uint32_t, std::string>> batch;
+    {
+      std::lock_guard<std::mutex> batchGuard(_batchMutex);
+      batch.swap(_batch);
+      _batchTimerId = 0;
+    }
+    if (batch.empty()) return;
+
+    std::string json;
+    if (batch.size() == 1) json = std::move(batch.front().second);
+    else {
+      //JSON-RPC 2.0 batch. Kodi answers with an array of responses which processData() splits up again.
+      size_t size = 2;
+      for (auto &request : batch) {
+        size += request.second.size() + 1;
+      }
+      json.reserve(size);
+      json.push_back('[');
+      for (auto &request : batch) {
+        if (json.size() > 1) json.push_back(',');
+        json.append(request.second);
+      }
+      json.push_back(']');
+    }
+
+    _out.printInfo("Info: Sending packet " + json);
+    if (!sendData(json)) {
+      for (auto &request : batch) {
+        finishRequest(request.first, BaseLib::PVariable());
+      }
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+bool KodiInterface::isPending(uint32_t requestId) {
+  std::lock_guard<std::mutex> requestsGuard(_requestsMutex);
+  return _requests.find(requestId) != _requests.end();
+}
+
+bool KodiInterface::finishRequest(uint32_t requestId, const BaseLib::PVariable &response) {
+  try {
+    std::shared_ptr<Request> request;
+    std::vector<std::shared_ptr<Request>> nextRequests;
+    {
+      std::lock_guard<std::mutex> requestsGuard(_requestsMutex);
+      auto requestIterator = _requests.find(requestId);
+      if (requestIterator == _requests.end()) return false;
+      request = requestIterator->second;
+      _requests.erase(requestIterator);
+      if (GD::eventLoop) GD::eventLoop->removeTimeout(request->timeoutId);
+
+      if (request->sent) {
+        _inFlightRequests--;
+        //Move queued requests into the free slots
+        while (_inFlightRequests < _maxInFlightRequests && !_queuedRequests.empty()) {
+          _inFlightRequests++;
+          _queuedRequests.front()->sent = true;
+          nextRequests.push_back(_queuedRequests.front());
+          _queuedRequests.pop_front();
+        }
+      } else {
+        auto queueIterator = std::find(_queuedRequests.begin(), _queuedRequests.end(), request);
+        if (queueIterator != _queuedRequests.end()) _queuedRequests.erase(queueIterator);
+      }
+    }
+
+    if (response && request->sendTime > 0) _requestTimes.add(steadyTime() - request->sendTime);
+    if (request->callback) request->callback(response);
+    for (auto &nextRequest : nextRequests) {
+      transmit(nextRequest);
+    }
+    return true;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+void KodiInterface::cancelRequests() {
+  try {
+    {
+      std::lock_guard<std::mutex> batchGuard(_batchMutex);
+      _batch.clear();
+      if (GD::eventLoop) GD::eventLoop->removeTimer(_batchTimerId);
+      _batchTimerId = 0;
+    }
+
+    std::vector<uint32_t> requestIds;
+    {
+      std::lock_guard<std::mutex> requestsGuard(_requestsMutex);
+      //Finish queued requests first, so they are not moved into the slots of the cancelled ones.
+      for (auto &request : _queuedRequests) {
+        requestIds.push_back(request->id);
+      }
+      for (auto &request : _requests) {
+        if (request.second->sent) requestIds.push_back(request.first);
+      }
     }
+    for (auto requestId : requestIds) {
+      finishRequest(requestId, BaseLib::PVariable());
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
 
-    if (!request->conditionVariable.wait_for(lock, std::chrono::milliseconds(10000), [&] { return request->mutexReady; })) {
-      _out.printError("Error: No response received to packet: " + json);
+bool KodiInterface::sendCommand(std::string &&request, bool wait) {
+  try {
+    if (_stopped) {
+      _out.printError("Error: Could not send packet to Kodi with hostname " + _hostname + ": Not connected.");
+      return true;
     }
-    response = request->response;
 
-    _requestsMutex.lock();
-    _requests.erase(requestId);
-    _requestsMutex.unlock();
+    if (wait) {
+      PVariable response;
+      return getResponse(std::move(request), response);
+    }
+    return sendRequest(std::move(request), std::function<void(const BaseLib::PVariable &response)>());
   }
   catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
-    _requestsMutex.unlock();
   }
+  return true;
 }
 
-void KodiInterface::sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet) {
+bool KodiInterface::sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet, bool wait) {
   try {
     if (!packet) {
       _out.printWarning("Warning: Packet was nullptr.");
-      return;
+      return true;
     }
 
     std::shared_ptr<KodiPacket> kodiPacket(std::dynamic_pointer_cast<KodiPacket>(packet));
-    if (!kodiPacket) return;
+    if (!kodiPacket) return true;
 
     PVariable json = kodiPacket->getJson();
-    if (!json) return;
+    if (!json) return true;
 
-    json->print(false, true);
+    std::string request;
+    if (!serializeRequest(json, request)) return true;
+    return sendCommand(std::move(request), wait);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return true;
+}
 
-    PVariable response;
-    getResponse(json, response);
+void KodiInterface::scheduleReconnect(int64_t delay) {
+  try {
+    if (!_listening || !GD::eventLoop) return;
+    std::weak_ptr<KodiInterface> weakInterface = shared_from_this();
+    std::lock_guard<std::mutex> socketGuard(_socketMutex);
+    GD::eventLoop->removeTimer(_reconnectTimerId);
+    _reconnectTimerId = GD::eventLoop->addTimer(delay, [weakInterface]() {
+      auto interface = weakInterface.lock();
+      if (!interface || !interface->enterCallback()) return;
+      interface->reconnect();
+      interface->leaveCallback();
+    });
   }
   catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
   }
 }
 
-void KodiInterface::reconnect() {
+void KodiInterface::connectionFailed() {
   try {
-    if (_connectedCallback) _connectedCallback(false);
-    _socket->Shutdown();
-    _out.printDebug("Connecting to Kodi with hostname " + _hostname + " on port " + std::to_string(_port) + "...");
-    _socket->Open();
-    _out.printInfo("Connected to Kodi with hostname " + _hostname + " on port " + std::to_string(_port) + ".");
-    _stopped = false;
-    if (_connectedCallback) _connectedCallback(true);
+    uint32_t attempts = 0;
+    int64_t delay = 0;
+    {
+      std::lock_guard<std::mutex> socketGuard(_socketMutex);
+      if (!_listening || _state == ConnectionState::stopped) return;
+      attempts = ++_reconnectAttempts;
+      _reconnects++;
+      //The first retry is immediate, so a quickly restarting Kodi is reconnected without delay.
+      if (attempts > 1) {
+        delay = _reconnectMinDelay;
+        for (uint32_t i = 2; i < attempts && delay < _reconnectMaxDelay; i++) {
+          delay *= 2;
+        }
+        if (delay > _reconnectMaxDelay) delay = _reconnectMaxDelay;
+        //Keep at least half of the delay, so peers disconnected at the same time don't reconnect at the same time.
+        delay = delay / 2 + BaseLib::HelperFunctions::getRandomNumber(0, (int32_t)(delay / 2));
+      }
+      _state = ConnectionState::waitingForReconnect;
+    }
+    if (attempts > 1) _out.printDebug("Debug: Reconnecting to Kodi with hostname " + _hostname + " in " + std::to_string(delay) + " ms (attempt " + std::to_string(attempts) + ").");
+    notifyReconnectScheduled(attempts, delay);
+    scheduleReconnect(delay);
   }
   catch (const std::exception &ex) {
-    _out.printDebug(ex.what());
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
   }
 }
 
-void KodiInterface::startListening() {
+void KodiInterface::configureNotifications() {
   try {
-    stopListening();
-    if (_hostname.empty()) return;
+    std::set<std::string> namespaces;
+    {
+      std::lock_guard<std::mutex> socketGuard(_socketMutex);
+      namespaces = _notificationNamespaces;
+    }
+    if (namespaces.empty()) return;
 
-    C1Net::TcpSocketInfo tcp_socket_info;
-    tcp_socket_info.read_timeout = 5000;
-    tcp_socket_info.write_timeout = 5000;
+    //All namespaces of "Configuration.Notifications". Everything else is reported by Kodi as "Other".
+    static const std::set<std::string> knownNamespaces{"Application", "AudioLibrary", "GUI", "Input", "Player", "Playlist", "PVR", "System", "VideoLibrary"};
+    auto notifications = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+    for (auto &knownNamespace : knownNamespaces) {
+      notifications->structValue->emplace(knownNamespace, std::make_shared<BaseLib::Variable>(namespaces.find(knownNamespace) != namespaces.end()));
+    }
+    bool other = false;
+    for (auto &notificationNamespace : namespaces) {
+      if (knownNamespaces.find(notificationNamespace) == knownNamespaces.end()) other = true;
+    }
+    notifications->structValue->emplace("Other", std::make_shared<BaseLib::Variable>(other));
 
-    C1Net::TcpSocketHostInfo tcp_socket_host_info{
-        .host = _hostname,
-        .port = (uint16_t)_port,
-        .connection_retries = 1
-    };
+    auto configuration = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+    configuration->structValue->emplace("notifications", notifications);
+    auto parameters = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+    parameters->structValue->emplace("configuration", configuration);
+    auto request = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+    request->structValue->emplace("jsonrpc", std::make_shared<BaseLib::Variable>(std::string("2.0")));
+    request->structValue->emplace("method", std::make_shared<BaseLib::Variable>(std::string("JSONRPC.SetConfiguration")));
+    request->structValue->emplace("params", parameters);
 
-    _socket = std::make_unique<C1Net::TcpSocket>(tcp_socket_info, tcp_socket_host_info);
+    std::weak_ptr<KodiInterface> weakInterface = shared_from_this();
+    sendRequest(request, [weakInterface](const BaseLib::PVariable &response) {
+      auto interface = weakInterface.lock();
+      if (!interface) return;
+      if (!response || response->structValue->find("error") != response->structValue->end()) {
+        interface->_out.printWarning("Warning: Could not disable unused notifications of Kodi with hostname " + interface->_hostname + ".");
+      } else interface->_out.printDebug("Debug: Disabled unused notifications of Kodi with hostname " + interface->_hostname + ".");
+    });
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
 
-    GD::bl->threadManager.start(_listenThread, true, &KodiInterface::listen, this);
+void KodiInterface::scheduleHeartbeat(int64_t delay) {
+  try {
+    if (!GD::eventLoop) return;
+    std::weak_ptr<KodiInterface> weakInterface = shared_from_this();
+    GD::eventLoop->removeTimer(_heartbeatTimerId);
+    _heartbeatTimerId = GD::eventLoop->addTimer(delay, [weakInterface]() {
+      auto interface = weakInterface.lock();
+      if (!interface || !interface->enterCallback()) return;
+      interface->heartbeat();
+      interface->leaveCallback();
+    });
   }
   catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
   }
 }
 
-void KodiInterface::stopListening() {
+void KodiInterface::heartbeat() {
   try {
-    if (_connectedCallback) _connectedCallback(false);
-    _stopCallbackThread = true;
-    GD::bl->threadManager.join(_listenThread);
-    _stopCallbackThread = false;
-    _socket->Shutdown();
+    int64_t interval = 0;
+    {
+      std::lock_guard<std::mutex> socketGuard(_socketMutex);
+      _heartbeatTimerId = 0;
+      if (_state != ConnectionState::connected || _heartbeatInterval <= 0) return;
+      interval = _heartbeatInterval;
+
+      //Only ping idle connections. Any received data proves the connection is alive.
+      int64_t idleTime = steadyTime() - _lastReceived;
+      if (idleTime < interval && _heartbeatMisses == 0) {
+        scheduleHeartbeat(interval - idleTime);
+        return;
+      }
+    }
+
+    auto request = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+    request->structValue->emplace("jsonrpc", std::make_shared<BaseLib::Variable>(std::string("2.0")));
+    request->structValue->emplace("method", std::make_shared<BaseLib::Variable>(std::string("JSONRPC.Ping")));
+    int64_t sendTime = steadyTime();
+    std::weak_ptr<KodiInterface> weakInterface = shared_from_this();
+    bool sent = sendRequest(request, [weakInterface, sendTime](const BaseLib::PVariable &response) {
+      auto interface = weakInterface.lock();
+      if (interface) interface->heartbeatResponse(sendTime, response);
+    }, (int32_t)interval);
+    if (!sent) {
+      std::lock_guard<std::mutex> socketGuard(_socketMutex);
+      if (_state == ConnectionState::connected) scheduleHeartbeat(interval);
+    }
   }
   catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
   }
 }
 
-void KodiInterface::listen() {
+void KodiInterface::heartbeatResponse(int64_t sendTime, const BaseLib::PVariable &response) {
   try {
-    uint32_t receivedBytes = 0;
-    int32_t bufferMax = 4096;
-    std::vector<char> buffer(bufferMax);
-    std::vector<char> data;
-    bool more_data = false;
+    bool answered = response && response->structValue->find("result") != response->structValue->end();
+    int64_t roundTripTime = steadyTime() - sendTime;
+    {
+      std::lock_guard<std::mutex> socketGuard(_socketMutex);
+      if (_state != ConnectionState::connected) return;
+      if (answered) {
+        _heartbeatMisses = 0;
+        scheduleHeartbeat(_heartbeatInterval);
+      } else {
+        _heartbeatMisses++;
+        if (_heartbeatMisses < _heartbeatMaxMisses) {
+          //Ping again right away. The ping's timeout already waited one interval.
+          scheduleHeartbeat(0);
+          return;
+        }
+      }
+    }
 
-    while (!_stopCallbackThread) {
-      if (_stopped) {
-        data.clear();
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-        if (_stopCallbackThread) return;
-        _out.printDebug("Debug: Connection to Kodi closed. Trying to reconnect...");
-        reconnect();
-        continue;
+    if (answered) {
+      _roundTripTimes.add(roundTripTime);
+      notifyRoundTripMeasured(roundTripTime);
+      return;
+    }
+
+    //Called from within finishRequest(), so the connection is closed from a separate task.
+    _out.printWarning("Warning: Kodi with hostname " + _hostname + " did not answer " + std::to_string(_heartbeatMaxMisses) + " pings. Reconnecting...");
+    std::weak_ptr<KodiInterface> weakInterface = shared_from_this();
+    GD::eventLoop->post([weakInterface]() {
+      auto interface = weakInterface.lock();
+      if (!interface || !interface->enterCallback()) return;
+      interface->closeSocket(true);
+      interface->notifyConnected(false);
+      interface->connectionFailed();
+      interface->leaveCallback();
+    });
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void KodiInterface::closeSocket(bool wait) {
+  try {
+    int32_t socketDescriptor = -1;
+    uint64_t registrationId = 0;
+    {
+      std::lock_guard<std::mutex> socketGuard(_socketMutex);
+      socketDescriptor = _socketDescriptor;
+      registrationId = _registrationId;
+      _socketDescriptor = -1;
+      _registrationId = 0;
+      _sendBuffer.clear();
+      _socketEventRunning = false;
+      if (_state == ConnectionState::connecting || _state == ConnectionState::connected) _state = ConnectionState::disconnected;
+      if (GD::eventLoop) {
+        GD::eventLoop->removeTimeout(_connectTimeoutId);
+        _connectTimeoutId = 0;
+        GD::eventLoop->removeTimer(_heartbeatTimerId);
+        _heartbeatTimerId = 0;
       }
-      try {
-        do {
-          receivedBytes = _socket->Read((uint8_t *)buffer.data(), buffer.size(), more_data);
-          if (receivedBytes > 0) {
-            data.insert(data.end(), buffer.begin(), buffer.begin() + receivedBytes);
-            if (data.size() > 1000000) {
-              _out.printError("Could not read from Kodi: Too much data.");
-              break;
-            }
-          }
-        } while (receivedBytes == (unsigned)bufferMax);
+    }
+    _stopped = true;
+    cancelRequests();
+    if (GD::eventLoop) GD::eventLoop->remove(registrationId, wait);
+    if (socketDescriptor != -1) {
+      ::shutdown(socketDescriptor, SHUT_RDWR);
+      ::close(socketDescriptor);
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void KodiInterface::reconnect() {
+  try {
+    notifyConnected(false);
+    closeSocket(false);
+    _out.printDebug("Connecting to Kodi with hostname " + _hostname + " on port " + std::to_string(_port) + "...");
+
+    //The previous resolver thread already handed over its result, so this doesn't block.
+    GD::bl->threadManager.join(_resolverThread);
+    std::weak_ptr<KodiInterface> weakInterface = shared_from_this();
+    GD::bl->threadManager.start(_resolverThread, true, &KodiInterface::resolve, this, weakInterface, _hostname, _port);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void KodiInterface::resolve(std::weak_ptr<KodiInterface> weakInterface, std::string hostname, int32_t port) {
+  try {
+    std::vector<Address> addresses;
+    struct addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *serverInfo = nullptr;
+    std::string portString = std::to_string(port);
+    int32_t result = getaddrinfo(hostname.c_str(), portString.c_str(), &hints, &serverInfo);
+    if (result != 0 || !serverInfo) _out.printDebug("Could not resolve hostname " + hostname + ": " + std::string(gai_strerror(result)));
+    for (struct addrinfo *info = serverInfo; info; info = info->ai_next) {
+      if (info->ai_addrlen > sizeof(sockaddr_storage)) continue;
+      Address address;
+      address.family = info->ai_family;
+      address.socketType = info->ai_socktype;
+      address.protocol = info->ai_protocol;
+      std::memcpy(&address.address, info->ai_addr, info->ai_addrlen);
+      address.addressLength = info->ai_addrlen;
+      addresses.push_back(address);
+    }
+    if (serverInfo) freeaddrinfo(serverInfo);
+
+    //Never lock the interface here. This thread must not release the last reference, because the destructor joins it.
+    if (!GD::eventLoop) return;
+    GD::eventLoop->post([weakInterface, addresses = std::move(addresses)]() mutable {
+      auto interface = weakInterface.lock();
+      if (!interface || !interface->enterCallback()) return;
+      interface->resolved(addresses);
+      interface->leaveCallback();
+    });
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void KodiInterface::resolved(std::vector<Address> &addresses) {
+  try {
+    if (addresses.empty()) {
+      connectionFailed();
+      return;
+    }
+    {
+      std::lock_guard<std::mutex> socketGuard(_socketMutex);
+      _addresses = std::move(addresses);
+      _addressIndex = 0;
+    }
+    connectNext();
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void KodiInterface::connectNext() {
+  try {
+    while (true) {
+      Address address;
+      {
+        std::lock_guard<std::mutex> socketGuard(_socketMutex);
+        if (_addressIndex >= _addresses.size()) break;
+        address = _addresses[_addressIndex];
       }
-      catch (const C1Net::TimeoutException &ex) {
-        data.clear();
+
+      int32_t socketDescriptor = ::socket(address.family, address.socketType | SOCK_NONBLOCK | SOCK_CLOEXEC, address.protocol);
+      if (socketDescriptor == -1) {
+        _out.printError("Error: Could not create socket: " + std::string(strerror(errno)));
+        std::lock_guard<std::mutex> socketGuard(_socketMutex);
+        _addressIndex++;
         continue;
       }
-      catch (const C1Net::ClosedException &ex) {
-        _stopped = true;
-        _out.printInfo("Info: " + std::string(ex.what()));
-        std::this_thread::sleep_for(std::chrono::milliseconds(10000));
+      int32_t noDelay = 1;
+      setsockopt(socketDescriptor, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+      int32_t result = ::connect(socketDescriptor, (struct sockaddr *)&address.address, address.addressLength);
+      if (result == -1 && errno != EINPROGRESS) {
+        _out.printDebug("Could not connect to Kodi with hostname " + _hostname + ": " + std::string(strerror(errno)));
+        ::close(socketDescriptor);
+        std::lock_guard<std::mutex> socketGuard(_socketMutex);
+        _addressIndex++;
         continue;
       }
-      catch (const C1Net::Exception &ex) {
-        _stopped = true;
-        _out.printError("Error: " + std::string(ex.what()));
-        std::this_thread::sleep_for(std::chrono::milliseconds(10000));
-        continue;
+
+      std::weak_ptr<KodiInterface> weakInterface = shared_from_this();
+      std::lock_guard<std::mutex> socketGuard(_socketMutex);
+      _socketDescriptor = socketDescriptor;
+      _state = ConnectionState::connecting;
+      //Connection establishment is signaled by EPOLLOUT. socketEvent() finishes the connection setup.
+      _registrationId = GD::eventLoop->add(socketDescriptor, EPOLLOUT, [weakInterface](uint32_t events) {
+        auto interface = weakInterface.lock();
+        if (!interface || !interface->enterCallback()) return;
+        interface->socketEvent(events);
+        interface->leaveCallback();
+      });
+      _connectTimeoutId = GD::eventLoop->addTimeout(5000, [weakInterface]() {
+        auto interface = weakInterface.lock();
+        if (!interface || !interface->enterCallback()) return;
+        interface->connectTimeout();
+        interface->leaveCallback();
+      });
+      return;
+    }
+
+    connectionFailed();
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void KodiInterface::addressFailed() {
+  {
+    std::lock_guard<std::mutex> socketGuard(_socketMutex);
+    _addressIndex++;
+  }
+  connectNext();
+}
+
+void KodiInterface::connectTimeout() {
+  try {
+    {
+      std::lock_guard<std::mutex> socketGuard(_socketMutex);
+      _connectTimeoutId = 0;
+      if (_state != ConnectionState::connecting) return;
+    }
+    _out.printDebug("Could not connect to Kodi with hostname " + _hostname + ": Timeout.");
+    closeSocket(true);
+    addressFailed();
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void KodiInterface::startListening() {
+  try {
+    stopListening();
+    if (_hostname.empty() || !GD::eventLoop) return;
+
+    {
+      std::lock_guard<std::mutex> socketGuard(_socketMutex);
+      _state = ConnectionState::waitingForReconnect;
+      _reconnectAttempts = 0;
+    }
+    _listening = true;
+    scheduleReconnect(0);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void KodiInterface::stopListening() {
+  try {
+    notifyConnected(false);
+    {
+      std::unique_lock<std::mutex> callbacksGuard(_callbacksMutex);
+      _listening = false;
+      _callbacksConditionVariable.wait(callbacksGuard, [&] { return _runningCallbacks == 0; });
+    }
+    if (GD::eventLoop) {
+      std::lock_guard<std::mutex> socketGuard(_socketMutex);
+      GD::eventLoop->removeTimer(_reconnectTimerId);
+      _reconnectTimerId = 0;
+    }
+    closeSocket(true);
+    GD::bl->threadManager.join(_resolverThread);
+    std::lock_guard<std::mutex> socketGuard(_socketMutex);
+    _state = ConnectionState::stopped;
+    _addresses.clear();
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void KodiInterface::socketEvent(uint32_t events) {
+  try {
+    bool connecting = false;
+    {
+      std::lock_guard<std::mutex> socketGuard(_socketMutex);
+      if (_socketDescriptor == -1) return;
+      connecting = (_state == ConnectionState::connecting);
+      _socketEventRunning = true;
+    }
+
+    if (connecting) {
+      int32_t error = 0;
+      socklen_t errorLength = sizeof(error);
+      if (getsockopt(_socketDescriptor, SOL_SOCKET, SO_ERROR, &error, &errorLength) == -1) error = errno;
+      if (error != 0) {
+        _out.printDebug("Could not connect to Kodi with hostname " + _hostname + ": " + std::string(strerror(error)));
+        closeSocket(false);
+        addressFailed();
+        return;
       }
-      if (data.empty() || data.size() > 1000000) continue;
 
-      if (GD::bl->debugLevel >= 5) {
-        std::string debug((char *)&data.at(0), data.size());
-        _out.printDebug("Debug: Packet received from Kodi: " + debug);
+      {
+        std::lock_guard<std::mutex> socketGuard(_socketMutex);
+        _state = ConnectionState::connected;
+        _reconnectAttempts = 0;
+        _heartbeatMisses = 0;
+        if (_heartbeatInterval > 0) scheduleHeartbeat(_heartbeatInterval);
+        GD::eventLoop->removeTimeout(_connectTimeoutId);
+        _connectTimeoutId = 0;
+        _socketEventRunning = false;
+        GD::eventLoop->rearm(_registrationId, socketEvents());
       }
+      _out.printInfo("Connected to Kodi with hostname " + _hostname + " on port " + std::to_string(_port) + ".");
+      _framer->reset();
+      _lastReceived = steadyTime();
+      _stopped = false;
+      notifyReconnectScheduled(0, 0);
+      notifyConnected(true);
+      configureNotifications();
+      return;
+    }
 
-      BaseLib::PVariable json;
-      uint32_t bytesRead = 0;
-      try {
-        while (bytesRead < data.size()) {
-          json = _jsonDecoder->decode(data, bytesRead);
-          if (bytesRead < data.size()) {
-            std::vector<char> newData(data.begin() + bytesRead, data.end());
-            data.swap(newData);
-            bytesRead = 0;
-            if (json) processData(json);
-          } else {
-            data.clear();
-            if (json) processData(json);
-            break;
-          }
-        }
+    if (events & EPOLLOUT) {
+      bool sent = false;
+      {
+        std::lock_guard<std::mutex> socketGuard(_socketMutex);
+        sent = _socketDescriptor == -1 || flushSendBuffer();
       }
-      catch (BaseLib::Rpc::JsonDecoderException &ex) {
+      if (!sent) {
+        closeSocket(false);
+        notifyConnected(false);
+        connectionFailed();
+        return;
+      }
+    }
+
+    if ((events & ~(uint32_t)EPOLLOUT) && !readData()) return;
+
+    std::lock_guard<std::mutex> socketGuard(_socketMutex);
+    _socketEventRunning = false;
+    if (_registrationId != 0) GD::eventLoop->rearm(_registrationId, socketEvents());
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+bool KodiInterface::readData() {
+  try {
+    while (true) {
+      size_t bufferSize = 0;
+      char *buffer = _framer->getWriteBuffer(bufferSize);
+      ssize_t receivedBytes = ::recv(_socketDescriptor, buffer, bufferSize, 0);
+      if (receivedBytes > 0) {
+        if (_capturing) capture(KodiCapture::Direction::inbound, buffer, receivedBytes);
+        _framer->commit(receivedBytes);
+        _bytesReceived += receivedBytes;
+        _lastReceived = steadyTime();
+        //Frames are processed right away, so only the current frame is buffered no matter how fast Kodi sends.
+        processFrames();
         continue;
       }
+      if (receivedBytes == -1) {
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        _out.printError("Error: " + std::string(strerror(errno)));
+      } else _out.printInfo("Info: Connection to Kodi closed.");
+
+      _out.printDebug("Debug: Connection to Kodi closed. Trying to reconnect...");
+      closeSocket(false);
+      notifyConnected(false);
+      connectionFailed();
+      return false;
     }
+
+    _framer->shrink();
   }
   catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
   }
+  return true;
 }
 
-void KodiInterface::processData(BaseLib::PVariable &json) {
+void KodiInterface::processFrames() {
+  uint64_t skippedFrames = _framer->skippedFrames();
+  _framer->process([this](const char *data, size_t size) { processFrame(data, size); });
+  if (_framer->skippedFrames() != skippedFrames) {
+    _skippedFrames = _framer->skippedFrames();
+    _out.printError("Could not read from Kodi: Too much data.");
+  }
+}
+
+bool KodiInterface::filterFrame(const char *data, size_t size, bool &notification) {
   try {
-    BaseLib::Struct::iterator idIterator = json->structValue->find("id");
-    if (idIterator != json->structValue->end()) {
-      _requestsMutex.lock();
-      std::map < uint32_t, std::shared_ptr < Request >> ::iterator
-      requestIterator = _requests.find(idIterator->second->integerValue);
-      if (requestIterator != _requests.end()) {
-        std::shared_ptr<Request> request = requestIterator->second;
-        _requestsMutex.unlock();
-        request->response = json;
-        {
-          std::lock_guard<std::mutex> lock(request->mutex);
-          request->mutexReady = true;
-        }
-        request->conditionVariable.notify_one();
+    notification = false;
+    //Batch responses are always parsed
+    if (size == 0 || data[0] != '{') return true;
+
+    std::string_view method;
+    int64_t id = 0;
+    bool idFound = false;
+    if (!KodiJsonDocument::sniff(data, size, method, id, idFound)) return true;
+
+    if (idFound) {
+      if (id >= 0 && id <= UINT32_MAX && isPending((uint32_t)id)) return true;
+      _unmatchedResponses++;
+      return false;
+    }
+
+    if (method.empty()) return true;
+    std::lock_guard<std::mutex> filterGuard(_filterMutex);
+    if (_mappedMethods.empty() || _mappedMethods.contains(method)) {
+      notification = true;
+      return true;
+    }
+    auto droppedIterator = _droppedNotifications.find(method);
+    if (droppedIterator == _droppedNotifications.end()) _droppedNotifications.emplace(std::string(method), 1);
+    else droppedIterator->second++;
+    return false;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return true;
+}
+
+bool KodiInterface::isStreamed(int64_t requestId) {
+  if (requestId < 0 || requestId > UINT32_MAX) return false;
+  std::lock_guard<std::mutex> requestsGuard(_requestsMutex);
+  auto requestIterator = _requests.find((uint32_t)requestId);
+  return requestIterator != _requests.end() && requestIterator->second->elementCallback;
+}
+
+void KodiInterface::processElement(int64_t requestId, const char *data, size_t size) {
+  try {
+    std::shared_ptr<Request> request;
+    {
+      std::lock_guard<std::mutex> requestsGuard(_requestsMutex);
+      auto requestIterator = _requests.find((uint32_t)requestId);
+      //The request might have timed out while the response was streamed.
+      if (requestIterator == _requests.end()) return;
+      request = requestIterator->second;
+    }
+
+    if (!_elementDocument.parse(data, size)) {
+      _out.printWarning("Warning: Could not decode element of streamed response: " + std::string(data, size));
+      return;
+    }
+    request->streamedElements++;
+    request->elementCallback(_elementDocument, _elementDocument.root());
+    _elementDocument.clear();
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void KodiInterface::streamFinished(int64_t requestId, bool complete) {
+  try {
+    if (!complete) {
+      _out.printError("Error: Streamed response was aborted, because an element exceeded the maximum frame size.");
+      finishRequest((uint32_t)requestId, BaseLib::PVariable());
+      return;
+    }
+
+    uint32_t streamedElements = 0;
+    {
+      std::lock_guard<std::mutex> requestsGuard(_requestsMutex);
+      auto requestIterator = _requests.find((uint32_t)requestId);
+      if (requestIterator == _requests.end()) return;
+      streamedElements = requestIterator->second->streamedElements;
+    }
+    auto result = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+    result->structValue->emplace("streamedElements", std::make_shared<BaseLib::Variable>(streamedElements));
+    auto response = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+    response->structValue->emplace("id", std::make_shared<BaseLib::Variable>((uint32_t)requestId));
+    response->structValue->emplace("jsonrpc", std::make_shared<BaseLib::Variable>(std::string("2.0")));
+    response->structValue->emplace("result", result);
+    finishRequest((uint32_t)requestId, response);
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void KodiInterface::processFrame(const char *data, size_t size) {
+  try {
+    if (GD::bl->debugLevel >= 5) _out.printDebug("Debug: Packet received from Kodi: " + std::string(data, size));
+    _framesReceived++;
+    bool notification = false;
+    if (!filterFrame(data, size, notification)) return;
+    if (notification) {
+      //Notifications are parsed by the worker processing them, so the reader only parses responses.
+      queueNotification(data, size);
+      return;
+    }
+
+    //The document only references the frame, which stays valid until this method returns.
+    auto decodeStart = std::chrono::steady_clock::now();
+    if (!_document.parse(data, size)) {
+      _out.printWarning("Warning: Could not decode packet from Kodi: " + std::string(data, size));
+      return;
+    }
+    _decodeTimes.add(elapsedMicroseconds(decodeStart));
+
+    uint32_t root = _document.root();
+    if (_document.node(root).type == KodiJsonDocument::Type::array) {
+      //Response to a batch request
+      for (uint32_t element = _document.node(root).firstChild; element != KodiJsonDocument::npos; element = _document.node(element).nextSibling) {
+        if (_document.node(element).type == KodiJsonDocument::Type::object && !processData(_document, element)) _unmatchedResponses++;
+      }
+    } else if (_document.node(root).type == KodiJsonDocument::Type::object && !processData(_document, root)) queueNotification(data, size);
+    _document.clear();
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+bool KodiInterface::processData(const KodiJsonDocument &document, uint32_t index) {
+  try {
+    uint32_t idIndex = document.find(index, "id");
+    if (idIndex != KodiJsonDocument::npos && document.node(idIndex).type == KodiJsonDocument::Type::number) {
+      uint32_t requestId = document.getInteger(idIndex);
+      //Only responses somebody waits for are converted to BaseLib::Variable.
+      if (isPending(requestId)) {
+        finishRequest(requestId, document.toVariable(index));
+        return true;
+      }
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+void KodiInterface::queueNotification(const char *data, size_t size) {
+  try {
+    if (_replaying) {
+      dispatchNotification(data, size, BaseLib::HelperFunctions::getTime());
+      return;
+    }
+    if (!_notifications->push(Notification{std::string(data, size), BaseLib::HelperFunctions::getTime()})) {
+      if (_overflowedNotifications++ == 0) _out.printWarning("Warning: Notification queue of Kodi with hostname " + _hostname + " is full. Dropping notifications.");
+      return;
+    }
+    //The flag is set as long as a worker processes the queue, so there is only one consumer at a time.
+    if (_processingNotifications.exchange(true, std::memory_order_acq_rel)) return;
+    std::weak_ptr<KodiInterface> weakInterface = shared_from_this();
+    GD::eventLoop->post([weakInterface]() {
+      auto interface = weakInterface.lock();
+      if (!interface) return;
+      if (!interface->enterCallback()) {
+        interface->_processingNotifications.store(false, std::memory_order_release);
         return;
-      } else _requestsMutex.unlock();
+      }
+      interface->processNotifications();
+      interface->leaveCallback();
+    });
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+void KodiInterface::processNotifications() {
+  try {
+    Notification notification;
+    while (true) {
+      while (_notifications->pop(notification)) {
+        dispatchNotification(notification.json.data(), notification.json.size(), notification.timeReceived);
+      }
+      _processingNotifications.store(false, std::memory_order_release);
+      //A notification queued after the last pop() but before the flag was cleared would not be processed otherwise.
+      if (_notifications->empty() || _processingNotifications.exchange(true, std::memory_order_acq_rel)) return;
+    }
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    _processingNotifications.store(false, std::memory_order_release);
+  }
+}
+
+void KodiInterface::dispatchNotification(const char *data, size_t size, int64_t timeReceived) {
+  try {
+    auto decodeStart = std::chrono::steady_clock::now();
+    if (!_notificationDocument.parse(data, size)) {
+      _out.printWarning("Warning: Could not decode packet from Kodi: " + std::string(data, size));
+      return;
+    }
+    _decodeTimes.add(elapsedMicroseconds(decodeStart));
+    uint32_t root = _notificationDocument.root();
+    if (_notificationDocument.node(root).type == KodiJsonDocument::Type::object) {
+      KodiPacket packet(_notificationDocument, root, timeReceived);
+      notifyPacketReceived(packet);
+    }
+    _notificationDocument.clear();
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+}
+
+bool KodiInterface::startCapture(const std::string &path) {
+  try {
+    std::unique_ptr<KodiCapture> capture(new KodiCapture());
+    if (!capture->create(path)) {
+      _out.printError("Error: Could not create capture file " + path + ".");
+      return false;
+    }
+    std::lock_guard<std::mutex> captureGuard(_captureMutex);
+    _capture = std::move(capture);
+    _capturing = true;
+    _out.printInfo("Info: Capturing traffic of Kodi with hostname " + _hostname + " to " + path + ".");
+    return true;
+  }
+  catch (const std::exception &ex) {
+    _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+  }
+  return false;
+}
+
+void KodiInterface::stopCapture() {
+  std::lock_guard<std::mutex> captureGuard(_captureMutex);
+  _capturing = false;
+  _capture.reset();
+}
+
+void KodiInterface::capture(KodiCapture::Direction direction, const char *data, size_t size) {
+  std::lock_guard<std::mutex> captureGuard(_captureMutex);
+  if (_capture) _capture->write(direction, data, size);
+}
+
+BaseLib::PVariable KodiInterface::replay(const std::string &path, bool realTime) {
+  try {
+    if (_listening) return BaseLib::Variable::createError(-32500, "Interface is connected.");
+    KodiCapture captureFile;
+    if (!captureFile.open(path)) return BaseLib::Variable::createError(-32500, "Could not open capture file.");
+
+    _replaying = true;
+    _framer->reset();
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+    uint64_t framesReceived = _framesReceived;
+    KodiCapture::Record record;
+    int64_t firstRecordTime = -1;
+    auto startTime = std::chrono::steady_clock::now();
+    while (captureFile.read(record)) {
+      if (record.direction != KodiCapture::Direction::inbound) continue;
+      if (firstRecordTime == -1) firstRecordTime = record.time;
+      if (realTime) std::this_thread::sleep_until(startTime + std::chrono::nanoseconds(record.time - firstRecordTime));
+
+      size_t position = 0;
+      while (position < record.data.size()) {
+        size_t bufferSize = 0;
+        char *buffer = _framer->getWriteBuffer(bufferSize);
+        size_t size = std::min(bufferSize, record.data.size() - position);
+        std::memcpy(buffer, record.data.data() + position, size);
+        _framer->commit(size);
+        position += size;
+      }
+      _framer->process([this](const char *data, size_t size) { processFrame(data, size); });
+      records++;
+      bytes += record.data.size();
     }
+    int64_t duration = elapsedMicroseconds(startTime);
+    _replaying = false;
+    _framer->reset();
 
-    std::shared_ptr<KodiPacket> packet(new KodiPacket(json, BaseLib::HelperFunctions::getTime()));
-    if (_packetReceivedCallback) _packetReceivedCallback(packet);
+    auto result = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+    result->structValue->emplace("records", std::make_shared<BaseLib::Variable>((int64_t)records));
+    result->structValue->emplace("bytes", std::make_shared<BaseLib::Variable>((int64_t)bytes));
+    result->structValue->emplace("frames", std::make_shared<BaseLib::Variable>((int64_t)(_framesReceived - framesReceived)));
+    result->structValue->emplace("duration", std::make_shared<BaseLib::Variable>(duration));
+    return result;
   }
   catch (const std::exception &ex) {
     _out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
   }
+  _replaying = false;
+  return BaseLib::Variable::createError(-32500, "Unknown application error.");
 }
 
 }
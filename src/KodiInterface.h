@@ -32,23 +32,214 @@
 
 #include <cstdint>
 
+#include "KodiCapture.h"
+#include "KodiHistogram.h"
+#include "KodiJsonFramer.h"
+#include "KodiMethodSet.h"
 #include "KodiPacket.h"
+#include "KodiSpscQueue.h"
 #include <homegear-base/BaseLib.h>
 
+#include <atomic>
+#include <deque>
+#include <set>
+#include <sys/socket.h>
+#include <thread>
+#include <unordered_map>
+
 namespace Kodi
 {
 
 using namespace BaseLib;
 
-class KodiInterface
+class KodiInterface : public std::enable_shared_from_this<KodiInterface>
 {
 public:
+	enum class ConnectionState : uint8_t
+	{
+		stopped,
+		disconnected,
+		connecting,
+		connected,
+		waitingForReconnect
+	};
+
 	KodiInterface();
 	virtual ~KodiInterface();
 
-	void setConnectedCallback(std::function<void(bool connected)> callback);
-	void setPacketReceivedCallback(std::function<void(std::shared_ptr<KodiPacket> packet)> callback);
-	void sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet);
+	/**
+	 * A peer using this connection. Several peers can share one connection to the same Kodi instance. Every decoded notification
+	 * is handed to all subscribers.
+	 */
+	struct Subscriber
+	{
+		uint64_t id = 0;
+		std::function<void(bool connected)> connected;
+		std::function<void(KodiPacket& packet)> packetReceived;
+
+		/**
+		 * Called whenever a reconnect is scheduled and after the connection was established. Gets the number of failed attempts since
+		 * the last successful connection and the delay in milliseconds until the next attempt. Both are "0" after the connection
+		 * was established.
+		 */
+		std::function<void(uint32_t attempts, int64_t delay)> reconnectScheduled;
+
+		/**
+		 * Called after every answered ping with the round trip time in milliseconds.
+		 */
+		std::function<void(int64_t roundTripTime)> roundTripMeasured;
+
+		/**
+		 * The notification namespaces (the part of the method before the dot, e. g. "Player") the subscriber handles. After
+		 * connecting, all namespaces no subscriber handles are disabled with "JSONRPC.SetConfiguration". When empty, Kodi's
+		 * configuration is not changed.
+		 */
+		std::set<std::string> namespaces;
+
+		/**
+		 * The notification methods the subscriber handles. Notifications no subscriber handles are dropped before they are parsed.
+		 * When empty, all notifications are passed on.
+		 */
+		std::vector<std::string> methods;
+	};
+
+	/**
+	 * Adds a subscriber. The "connected" callback is called immediately with the current state.
+	 */
+	void subscribe(const Subscriber& subscriber);
+
+	/**
+	 * Removes a subscriber and waits until none of its callbacks is executed anymore. Must not be called from within a callback.
+	 */
+	void unsubscribe(uint64_t subscriberId);
+
+	/**
+	 * First half of unsubscribe(). Removes the subscriber without waiting, so it can be called while holding other locks.
+	 *
+	 * @return Returns the number of remaining subscribers.
+	 */
+	size_t removeSubscriber(uint64_t subscriberId);
+
+	/**
+	 * Second half of unsubscribe(). Waits until callbacks started before removeSubscriber() returned and updates the notification
+	 * filter. Must not be called from within a callback.
+	 */
+	void finishUnsubscribe();
+	size_t subscriberCount();
+
+	/**
+	 * Sets the limits of the reconnect backoff. After the first failed attempt the connection is retried immediately, afterwards the delay
+	 * starts at "minDelay" and doubles with every attempt up to "maxDelay". A random jitter of up to half the delay is subtracted.
+	 */
+	void setReconnectDelays(int64_t minDelay, int64_t maxDelay);
+	ConnectionState getConnectionState();
+
+	/**
+	 * Configures the heartbeat. When nothing was received for "interval" milliseconds, "JSONRPC.Ping" is sent. After "maxMisses"
+	 * pings in a row without response, the connection is closed and reestablished.
+	 *
+	 * @param interval The idle time in milliseconds before a ping is sent. "0" disables the heartbeat.
+	 */
+	void setHeartbeat(int64_t interval, int32_t maxMisses);
+
+	/**
+	 * @return Returns the round trip times of the last pings.
+	 */
+	KodiHistogram& getRoundTripTimes() { return _roundTripTimes; }
+
+	/**
+	 * @return Returns the number of dropped notifications by method.
+	 */
+	std::map<std::string, uint64_t> getDroppedNotifications();
+
+	/**
+	 * @return Returns the number of dropped responses to requests which already timed out or were never sent.
+	 */
+	uint64_t getUnmatchedResponseCount() { return _unmatchedResponses; }
+
+	/**
+	 * @return Returns the number of notifications dropped, because processing could not keep up and the notification queue was full.
+	 */
+	uint64_t getOverflowedNotificationCount() { return _overflowedNotifications; }
+
+	/**
+	 * @return Returns a struct with the transport counters of this connection: bytes and frames in both directions, the decode
+	 * times in microseconds, the request round trip times in milliseconds, timeouts, reconnects, pending requests and dropped
+	 * frames. The counters are never reset.
+	 */
+	BaseLib::PVariable getMetrics();
+
+	/**
+	 * Formats the struct returned by getMetrics() for the CLI.
+	 */
+	static std::string printMetrics(const BaseLib::PVariable& metrics);
+
+	/**
+	 * Records all data sent and received from now on to "path". A running capture is stopped.
+	 *
+	 * @see KodiCapture
+	 */
+	bool startCapture(const std::string& path);
+	void stopCapture();
+	bool isCapturing() { return _capturing; }
+
+	/**
+	 * Feeds the inbound data of a capture through the framer, the response matching and the subscribers like data received
+	 * from Kodi. Notifications are processed on the calling thread, so all packets are passed to the subscribers when the method
+	 * returns. Must only be called on an interface which is not listening.
+	 *
+	 * @param realTime When true, the recorded timing is reproduced. Otherwise the data is processed as fast as possible.
+	 * @return Returns a struct with the number of records, bytes and frames processed and the duration in microseconds or an error.
+	 */
+	BaseLib::PVariable replay(const std::string& path, bool realTime);
+
+	/**
+	 * Queues a packet on the outbound queue of this connection.
+	 *
+	 * @param packet The packet to send.
+	 * @param wait When true, the method returns after the response was received or the request timed out. Otherwise it returns immediately.
+	 * @return Returns false when the outbound queue is full and the packet was dropped.
+	 */
+	bool sendPacket(std::shared_ptr<BaseLib::Systems::Packet> packet, bool wait = true);
+
+	/**
+	 * Sends a request without waiting for the response.
+	 *
+	 * @param request The request to send. The id is added by this method.
+	 * @param callback Called with the response or with nullptr on timeout or connection loss. Executed on an event loop thread, so it must not block.
+	 * @param timeout The deadline in milliseconds for the whole request, including the time spent in the outbound queue. "-1" uses "requestTimeout" from kodi.conf.
+	 * @return Returns false when the request was not queued. The callback is not called in that case.
+	 */
+	bool sendRequest(BaseLib::PVariable& request, std::function<void(const BaseLib::PVariable& response)> callback, int32_t timeout = -1);
+
+	/**
+	 * Sends a serialized request without waiting for the response.
+	 *
+	 * @param request The serialized request object without the closing brace, ending with "\"id\":". The id and the closing brace are appended by this method.
+	 * @see sendRequest(BaseLib::PVariable&, std::function<void(const BaseLib::PVariable&)>, int32_t)
+	 */
+	bool sendRequest(std::string&& request, std::function<void(const BaseLib::PVariable& response)> callback, int32_t timeout = -1);
+
+	/**
+	 * Sends a request whose response contains a large array, e. g. "VideoLibrary.GetMovies". The response is not buffered as a
+	 * whole. Instead each element of the first array in "result" is parsed and handed to "elementCallback" as soon as it was
+	 * received, so memory usage only depends on the size of a single element.
+	 *
+	 * @param elementCallback Called for every element on the receiving thread. The document is only valid during the call.
+	 * @param callback Called when the response is complete. On success "result" only contains "streamedElements", the number of
+	 * elements. Error responses are passed unchanged, timeouts and aborted responses as nullptr.
+	 * @see sendRequest(BaseLib::PVariable&, std::function<void(const BaseLib::PVariable&)>, int32_t)
+	 */
+	bool sendStreamingRequest(BaseLib::PVariable& request, std::function<void(const KodiJsonDocument& document, uint32_t element)> elementCallback, std::function<void(const BaseLib::PVariable& response)> callback, int32_t timeout = -1);
+
+	/**
+	 * Like sendPacket(), but with a request serialized as described for sendRequest(std::string&&, std::function<void(const BaseLib::PVariable&)>, int32_t).
+	 */
+	bool sendCommand(std::string&& request, bool wait = true);
+
+	size_t getQueuedRequestCount();
+	int32_t getInFlightRequestCount();
+	uint64_t getDroppedRequestCount() { return _droppedRequests; }
 	std::string getHostname();
 	void setHostname(std::string& hostname);
 	int32_t getPort();
@@ -59,39 +250,307 @@ protected:
 	class Request
 	{
 	public:
-		std::mutex mutex;
-		std::condition_variable conditionVariable;
-		bool mutexReady = false;
-		BaseLib::PVariable response;
+		uint32_t id = 0;
+		std::string json;
+		std::function<void(const BaseLib::PVariable& response)> callback;
+		std::function<void(const KodiJsonDocument& document, uint32_t element)> elementCallback;
+		uint32_t streamedElements = 0;
+		uint64_t timeoutId = 0;
+		bool sent = false;
+		int64_t sendTime = 0;
 
 		Request() {}
 		virtual ~Request() {}
 	private:
 	};
 
+	struct Notification
+	{
+		std::string json;
+		int64_t timeReceived = 0;
+	};
+
+	struct Address
+	{
+		int32_t family = 0;
+		int32_t socketType = 0;
+		int32_t protocol = 0;
+		struct sockaddr_storage address{};
+		socklen_t addressLength = 0;
+	};
+
 	BaseLib::Output _out;
-	std::unique_ptr<C1Net::TcpSocket> _socket;
 	std::string _hostname;
 	int32_t _port = 9090;
 	std::unique_ptr<BaseLib::Rpc::JsonEncoder> _jsonEncoder;
-	std::unique_ptr<BaseLib::Rpc::JsonDecoder> _jsonDecoder;
-	std::function<void(bool connected)> _connectedCallback;
-	std::function<void(std::shared_ptr<KodiPacket> packet)> _packetReceivedCallback;
 
-	std::thread _listenThread;
-	bool _stopCallbackThread = false;
-	bool _stopped = true;
+	//{{{ Subscribers, guarded by _subscribersMutex. The list is replaced on change, so callbacks are called without holding the lock.
+	std::mutex _subscribersMutex;
+	std::condition_variable _subscribersConditionVariable;
+	std::shared_ptr<const std::vector<Subscriber>> _subscribers;
+	int32_t _runningDispatches = 0;
+	//}}}
 
-	uint32_t _currentRequestId = 0;
-	std::mutex _getResponseMutex;
+	//{{{ Socket state, guarded by _socketMutex
+	std::mutex _socketMutex;
+	int32_t _socketDescriptor = -1;
+	uint64_t _registrationId = 0;
+	uint64_t _reconnectTimerId = 0;
+	uint64_t _connectTimeoutId = 0;
+	ConnectionState _state = ConnectionState::stopped;
+	std::set<std::string> _notificationNamespaces;
+	uint32_t _reconnectAttempts = 0;
+	int64_t _reconnectMinDelay = 1000;
+	int64_t _reconnectMaxDelay = 60000;
+	std::string _sendBuffer;
+	bool _socketEventRunning = false;
+	std::vector<Address> _addresses;
+	size_t _addressIndex = 0;
+	//}}}
+
+	//Only used by reconnect(), stopListening() and the destructor, which never run at the same time.
+	std::thread _resolverThread;
+
+	//{{{ Heartbeat, guarded by _socketMutex
+	int64_t _heartbeatInterval = 0;
+	int32_t _heartbeatMaxMisses = 3;
+	int32_t _heartbeatMisses = 0;
+	uint64_t _heartbeatTimerId = 0;
+	//}}}
+
+	std::atomic<int64_t> _lastReceived{0};
+	KodiHistogram _roundTripTimes;
+
+	//{{{ Capture, guarded by _captureMutex
+	std::mutex _captureMutex;
+	std::atomic_bool _capturing{false};
+	std::unique_ptr<KodiCapture> _capture;
+	//}}}
+
+	//{{{ Metrics
+	std::atomic<uint64_t> _bytesReceived{0};
+	std::atomic<uint64_t> _bytesSent{0};
+	std::atomic<uint64_t> _framesReceived{0};
+	std::atomic<uint64_t> _framesSent{0};
+	std::atomic<uint64_t> _timeouts{0};
+	std::atomic<uint64_t> _reconnects{0};
+	std::atomic<uint64_t> _skippedFrames{0};
+	KodiHistogram _decodeTimes;
+	KodiHistogram _requestTimes;
+	//}}}
+
+	//{{{ Callbacks from the event loop
+	std::mutex _callbacksMutex;
+	std::condition_variable _callbacksConditionVariable;
+	int32_t _runningCallbacks = 0;
+	std::atomic_bool _listening{false};
+	//}}}
+
+	std::atomic_bool _stopped{true};
+
+	//{{{ Receive path, only used by the socket callback
+	std::unique_ptr<KodiJsonFramer> _framer;
+	KodiJsonDocument _document;
+	KodiJsonDocument _elementDocument;
+	//}}}
+
+	//{{{ Handoff of notifications from the socket reader to the worker processing them
+	std::unique_ptr<KodiSpscQueue<Notification>> _notifications;
+	std::atomic_bool _processingNotifications{false};
+
+	//Set during replay(), notifications are processed by the reader then.
+	bool _replaying = false;
+	std::atomic<uint64_t> _overflowedNotifications{0};
+
+	//Only used by processNotifications()
+	KodiJsonDocument _notificationDocument;
+	//}}}
+
+	//{{{ Notification filter, guarded by _filterMutex
+	std::mutex _filterMutex;
+	KodiMethodSet _mappedMethods;
+	std::map<std::string, uint64_t, std::less<>> _droppedNotifications;
+	std::atomic<uint64_t> _unmatchedResponses{0};
+	//}}}
+
+	//{{{ Pipelined requests, guarded by _requestsMutex
+	int32_t _maxInFlightRequests = 8;
+	int32_t _requestTimeout = 10000;
+	size_t _maxQueuedRequests = 100;
+	int32_t _inFlightRequests = 0;
+	std::deque<std::shared_ptr<Request>> _queuedRequests;
+	std::atomic<uint64_t> _droppedRequests{0};
+	//}}}
+
+	//{{{ Batching of outbound requests
+	int32_t _batchWindow = 0;
+	std::mutex _batchMutex;
+	std::vector<std::pair<uint32_t, std::string>> _batch;
+	uint64_t _batchTimerId = 0;
+	//}}}
+
+	std::atomic<uint32_t> _currentRequestId{0};
 	std::mutex _requestsMutex;
-	std::map<uint32_t, std::shared_ptr<Request>> _requests;
+	std::unordered_map<uint32_t, std::shared_ptr<Request>> _requests;
 	std::mutex _sendMutex;
 
-	void getResponse(BaseLib::PVariable& request, BaseLib::PVariable& response);
+	bool enterCallback();
+	void leaveCallback();
+
+	/**
+	 * Returns the current subscribers. Every call must be paired with leaveDispatch().
+	 */
+	std::shared_ptr<const std::vector<Subscriber>> enterDispatch();
+	void leaveDispatch();
+	void notifyConnected(bool connected);
+	void notifyReconnectScheduled(uint32_t attempts, int64_t delay);
+	void notifyRoundTripMeasured(int64_t roundTripTime);
+	void notifyPacketReceived(KodiPacket& packet);
+
+	/**
+	 * Merges the namespaces and methods of all subscribers.
+	 *
+	 * @return Returns true when the notification namespaces changed.
+	 */
+	bool updateFilter();
+	void scheduleReconnect(int64_t delay);
+
+	/**
+	 * Calculates the backoff delay and schedules the next connection attempt.
+	 */
+	void connectionFailed();
+	void configureNotifications();
+
+	/**
+	 * Schedules the next heartbeat. Must be called with _socketMutex locked.
+	 */
+	void scheduleHeartbeat(int64_t delay);
+	void heartbeat();
+	void heartbeatResponse(int64_t sendTime, const BaseLib::PVariable& response);
+	void closeSocket(bool wait);
+
+	/**
+	 * Writes "data" to the socket without blocking. Data the socket doesn't accept immediately is appended to the send buffer, which
+	 * is written when the socket signals EPOLLOUT.
+	 */
+	bool sendData(const std::string& data);
+
+	/**
+	 * Writes as much of the send buffer as the socket accepts. Must be called with _socketMutex locked.
+	 *
+	 * @return Returns false on socket errors.
+	 */
+	bool flushSendBuffer();
+
+	/**
+	 * Returns the events to wait for. EPOLLOUT is only included while the send buffer is not empty. Must be called with _socketMutex locked.
+	 */
+	uint32_t socketEvents();
+
+	/**
+	 * Sends a request and waits for the response with the same id. Multiple requests can be in flight at the same time, up to the
+	 * limit set with "maxInFlightRequests" in kodi.conf. Further requests wait in the outbound queue.
+	 *
+	 * @param request The serialized request as described for sendRequest().
+	 * @param[out] response The response or nullptr on timeout.
+	 * @param timeout The deadline in milliseconds for the whole request. "-1" uses "requestTimeout" from kodi.conf.
+	 * @return Returns false when the request was not queued.
+	 */
+	bool getResponse(std::string&& request, BaseLib::PVariable& response, int32_t timeout = -1);
+
+	/**
+	 * Encodes "request" in the form expected by sendRequest(std::string&&, std::function<void(const BaseLib::PVariable&)>, int32_t).
+	 */
+	bool serializeRequest(BaseLib::PVariable& request, std::string& json);
+	void cancelRequests();
+
+	/**
+	 * Assigns the id and sends the request or puts it into the outbound queue.
+	 */
+	bool submitRequest(std::shared_ptr<Request>& request, int32_t timeout);
+	void transmit(std::shared_ptr<Request>& request);
+	void requestTimeout(uint32_t requestId);
+
+	/**
+	 * Removes the request, calls its callback and sends the next queued request.
+	 *
+	 * @return Returns false when no request with this id is pending.
+	 */
+	bool finishRequest(uint32_t requestId, const BaseLib::PVariable& response);
+	bool isPending(uint32_t requestId);
+
+	/**
+	 * Sends a request directly or, when "batchWindow" is set in kodi.conf, adds it to the current batch.
+	 *
+	 * @return Returns false when the request could not be sent. Send errors of batched requests are reported through finishRequest().
+	 */
+	bool queueRequest(uint32_t requestId, std::string& json);
+	void flushBatch();
+	/**
+	 * Closes the socket and resolves the hostname on a separate thread, so a slow DNS server doesn't block the event loop. The
+	 * result is handed to resolved().
+	 */
 	void reconnect();
-	void listen();
-	void processData(BaseLib::PVariable& json);
+	void resolve(std::weak_ptr<KodiInterface> weakInterface, std::string hostname, int32_t port);
+	void resolved(std::vector<Address>& addresses);
+
+	/**
+	 * Starts a non-blocking connection to the address at _addressIndex. Addresses which fail immediately are skipped. When no address
+	 * is left, the connection attempt failed.
+	 */
+	void connectNext();
+
+	/**
+	 * Called when the connection to the current address failed. Tries the next address.
+	 */
+	void addressFailed();
+	void connectTimeout();
+	void socketEvent(uint32_t events);
+
+	/**
+	 * @return Returns false when the connection was closed.
+	 */
+	bool readData();
+
+	/**
+	 * Hands all complete frames in the framer to processFrame().
+	 */
+	void processFrames();
+	void processFrame(const char* data, size_t size);
+
+	/**
+	 * Checks "method" and "id" of a frame without parsing it.
+	 *
+	 * @param[out] notification Set to true when the frame is a notification which doesn't need to be parsed by the reader.
+	 * @return Returns false when the frame can be dropped.
+	 */
+	bool filterFrame(const char* data, size_t size, bool& notification);
+
+	/**
+	 * Copies a notification to the notification queue and makes sure a worker processes it. Only called by the socket reader.
+	 */
+	void queueNotification(const char* data, size_t size);
+
+	/**
+	 * Parses the queued notifications and passes them to the subscribers. Only one worker executes this at a time.
+	 */
+	void processNotifications();
+
+	/**
+	 * Parses a notification and passes it to the subscribers. Only called by the notification consumer.
+	 */
+	void dispatchNotification(const char* data, size_t size, int64_t timeReceived);
+	void capture(KodiCapture::Direction direction, const char* data, size_t size);
+	bool isStreamed(int64_t requestId);
+	void processElement(int64_t requestId, const char* data, size_t size);
+	void streamFinished(int64_t requestId, bool complete);
+
+	/**
+	 * Finishes the request a response belongs to.
+	 *
+	 * @return Returns false when no request waits for the data.
+	 */
+	bool processData(const KodiJsonDocument& document, uint32_t index);
 };
 
 }
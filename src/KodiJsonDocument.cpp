@@ -0,0 +1,425 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiJsonDocument.h"
+
+#include <charconv>
+
+namespace Kodi
+{
+
+bool KodiJsonDocument::parse(const char* data, size_t size)
+{
+	_nodes.clear();
+	_position = data;
+	_end = data + size;
+	_nodes.emplace_back();
+	if(!parseValue(0, 0))
+	{
+		_nodes.clear();
+		return false;
+	}
+	return true;
+}
+
+void KodiJsonDocument::skipWhitespace()
+{
+	while(_position < _end && (*_position == ' ' || *_position == '\n' || *_position == '\r' || *_position == '\t')) _position++;
+}
+
+bool KodiJsonDocument::parseString(std::string_view& value, bool& escaped)
+{
+	//_position is at the opening quote
+	_position++;
+	const char* start = _position;
+	while(_position < _end)
+	{
+		if(*_position == '\\')
+		{
+			escaped = true;
+			_position += 2;
+			continue;
+		}
+		if(*_position == '"')
+		{
+			value = std::string_view(start, _position - start);
+			_position++;
+			return true;
+		}
+		_position++;
+	}
+	return false;
+}
+
+bool KodiJsonDocument::parseValue(uint32_t index, uint32_t depth)
+{
+	if(depth > 256) return false;
+	skipWhitespace();
+	if(_position >= _end) return false;
+
+	char c = *_position;
+	if(c == '{' || c == '[')
+	{
+		bool isObject = (c == '{');
+		_nodes[index].type = isObject ? Type::object : Type::array;
+		char endCharacter = isObject ? '}' : ']';
+		_position++;
+		skipWhitespace();
+		if(_position < _end && *_position == endCharacter)
+		{
+			_position++;
+			return true;
+		}
+
+		uint32_t lastChild = npos;
+		while(_position < _end)
+		{
+			std::string_view key;
+			if(isObject)
+			{
+				skipWhitespace();
+				bool keyEscaped = false;
+				if(_position >= _end || *_position != '"' || !parseString(key, keyEscaped)) return false;
+				skipWhitespace();
+				if(_position >= _end || *_position != ':') return false;
+				_position++;
+			}
+
+			//Don't keep references into _nodes here, emplace_back might reallocate.
+			uint32_t child = _nodes.size();
+			_nodes.emplace_back();
+			_nodes[child].key = key;
+			if(lastChild == npos) _nodes[index].firstChild = child;
+			else _nodes[lastChild].nextSibling = child;
+			lastChild = child;
+			if(!parseValue(child, depth + 1)) return false;
+
+			skipWhitespace();
+			if(_position >= _end) return false;
+			if(*_position == ',')
+			{
+				_position++;
+				continue;
+			}
+			if(*_position == endCharacter)
+			{
+				_position++;
+				return true;
+			}
+			return false;
+		}
+		return false;
+	}
+	else if(c == '"')
+	{
+		_nodes[index].type = Type::string;
+		bool escaped = false;
+		std::string_view value;
+		if(!parseString(value, escaped)) return false;
+		_nodes[index].value = value;
+		_nodes[index].escaped = escaped;
+		return true;
+	}
+	else if(c == 't' || c == 'f' || c == 'n')
+	{
+		std::string_view literal = (c == 't') ? "true" : ((c == 'f') ? "false" : "null");
+		if((size_t)(_end - _position) < literal.size() || std::string_view(_position, literal.size()) != literal) return false;
+		_nodes[index].type = (c == 'n') ? Type::null : Type::boolean;
+		_nodes[index].value = std::string_view(_position, literal.size());
+		_position += literal.size();
+		return true;
+	}
+	else if(c == '-' || (c >= '0' && c <= '9'))
+	{
+		const char* start = _position;
+		_position++;
+		while(_position < _end && ((*_position >= '0' && *_position <= '9') || *_position == '.' || *_position == 'e' || *_position == 'E' || *_position == '-' || *_position == '+')) _position++;
+		_nodes[index].type = Type::number;
+		_nodes[index].value = std::string_view(start, _position - start);
+		return true;
+	}
+	return false;
+}
+
+uint32_t KodiJsonDocument::find(uint32_t object, std::string_view key) const
+{
+	if(object >= _nodes.size() || _nodes[object].type != Type::object) return npos;
+	for(uint32_t child = _nodes[object].firstChild; child != npos; child = _nodes[child].nextSibling)
+	{
+		if(_nodes[child].key == key) return child;
+	}
+	return npos;
+}
+
+uint32_t KodiJsonDocument::find(const std::vector<std::string>& keyPath) const
+{
+	uint32_t index = root();
+	for(auto& key : keyPath)
+	{
+		index = find(index, key);
+		if(index == npos) return npos;
+	}
+	return index;
+}
+
+void KodiJsonDocument::appendUtf8(std::string& target, uint32_t codePoint)
+{
+	if(codePoint < 0x80) target.push_back((char)codePoint);
+	else if(codePoint < 0x800)
+	{
+		target.push_back((char)(0xC0 | (codePoint >> 6)));
+		target.push_back((char)(0x80 | (codePoint & 0x3F)));
+	}
+	else if(codePoint < 0x10000)
+	{
+		target.push_back((char)(0xE0 | (codePoint >> 12)));
+		target.push_back((char)(0x80 | ((codePoint >> 6) & 0x3F)));
+		target.push_back((char)(0x80 | (codePoint & 0x3F)));
+	}
+	else
+	{
+		target.push_back((char)(0xF0 | (codePoint >> 18)));
+		target.push_back((char)(0x80 | ((codePoint >> 12) & 0x3F)));
+		target.push_back((char)(0x80 | ((codePoint >> 6) & 0x3F)));
+		target.push_back((char)(0x80 | (codePoint & 0x3F)));
+	}
+}
+
+std::string KodiJsonDocument::getString(uint32_t index) const
+{
+	if(index >= _nodes.size()) return "";
+	const Node& node = _nodes[index];
+	if(!node.escaped) return std::string(node.value);
+
+	std::string result;
+	result.reserve(node.value.size());
+	const char* position = node.value.data();
+	const char* end = position + node.value.size();
+	while(position < end)
+	{
+		if(*position != '\\' || position + 1 >= end)
+		{
+			result.push_back(*position++);
+			continue;
+		}
+		position++;
+		switch(*position)
+		{
+		case 'b': result.push_back('\b'); break;
+		case 'f': result.push_back('\f'); break;
+		case 'n': result.push_back('\n'); break;
+		case 'r': result.push_back('\r'); break;
+		case 't': result.push_back('\t'); break;
+		case 'u':
+		{
+			uint32_t codePoint = 0;
+			if(end - position < 5 || std::from_chars(position + 1, position + 5, codePoint, 16).ptr != position + 5) break;
+			position += 4;
+			if(codePoint >= 0xD800 && codePoint <= 0xDBFF && end - position >= 7 && position[1] == '\\' && position[2] == 'u')
+			{
+				uint32_t lowSurrogate = 0;
+				if(std::from_chars(position + 3, position + 7, lowSurrogate, 16).ptr == position + 7 && lowSurrogate >= 0xDC00 && lowSurrogate <= 0xDFFF)
+				{
+					codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowSurrogate - 0xDC00);
+					position += 6;
+				}
+			}
+			appendUtf8(result, codePoint);
+			break;
+		}
+		default: result.push_back(*position); break;
+		}
+		position++;
+	}
+	return result;
+}
+
+int64_t KodiJsonDocument::getInteger(uint32_t index) const
+{
+	if(index >= _nodes.size()) return 0;
+	const Node& node = _nodes[index];
+	if(node.type == Type::boolean) return node.value.front() == 't';
+	if(node.type != Type::number) return 0;
+	int64_t value = 0;
+	auto result = std::from_chars(node.value.data(), node.value.data() + node.value.size(), value);
+	if(result.ptr != node.value.data() + node.value.size())
+	{
+		double decimalValue = 0;
+		std::from_chars(node.value.data(), node.value.data() + node.value.size(), decimalValue);
+		value = (int64_t)decimalValue;
+	}
+	return value;
+}
+
+BaseLib::PVariable KodiJsonDocument::toVariable(uint32_t index) const
+{
+	if(index >= _nodes.size()) return BaseLib::PVariable();
+	const Node& node = _nodes[index];
+	switch(node.type)
+	{
+	case Type::null:
+		return std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tVoid);
+	case Type::boolean:
+		return std::make_shared<BaseLib::Variable>(node.value.front() == 't');
+	case Type::number:
+	{
+		if(node.value.find_first_of(".eE") != std::string_view::npos)
+		{
+			double value = 0;
+			std::from_chars(node.value.data(), node.value.data() + node.value.size(), value);
+			return std::make_shared<BaseLib::Variable>(value);
+		}
+		int64_t value = getInteger(index);
+		if(value >= INT32_MIN && value <= INT32_MAX) return std::make_shared<BaseLib::Variable>((int32_t)value);
+		return std::make_shared<BaseLib::Variable>(value);
+	}
+	case Type::string:
+		return std::make_shared<BaseLib::Variable>(getString(index));
+	case Type::array:
+	{
+		auto array = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tArray);
+		for(uint32_t child = node.firstChild; child != npos; child = _nodes[child].nextSibling)
+		{
+			array->arrayValue->push_back(toVariable(child));
+		}
+		return array;
+	}
+	case Type::object:
+	{
+		auto object = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+		for(uint32_t child = node.firstChild; child != npos; child = _nodes[child].nextSibling)
+		{
+			object->structValue->emplace(std::string(_nodes[child].key), toVariable(child));
+		}
+		return object;
+	}
+	}
+	return BaseLib::PVariable();
+}
+
+bool KodiJsonDocument::sniff(const char* data, size_t size, std::string_view& method, int64_t& id, bool& idFound)
+{
+	method = std::string_view();
+	idFound = false;
+	const char* position = data;
+	const char* end = data + size;
+	auto skipWhitespace = [&]() { while(position < end && (*position == ' ' || *position == '\n' || *position == '\r' || *position == '\t')) position++; };
+
+	skipWhitespace();
+	if(position >= end || *position != '{') return false;
+	position++;
+	while(true)
+	{
+		skipWhitespace();
+		if(position >= end) return false;
+		if(*position == '}') return true;
+		if(*position != '"') return false;
+
+		const char* keyStart = ++position;
+		while(position < end && *position != '"')
+		{
+			if(*position == '\\') return false;
+			position++;
+		}
+		if(position >= end) return false;
+		std::string_view key(keyStart, position - keyStart);
+		position++;
+		skipWhitespace();
+		if(position >= end || *position != ':') return false;
+		position++;
+		skipWhitespace();
+		if(position >= end) return false;
+
+		if(key == "method" && *position == '"')
+		{
+			const char* methodStart = ++position;
+			while(position < end && *position != '"')
+			{
+				if(*position == '\\') return false;
+				position++;
+			}
+			if(position >= end) return false;
+			method = std::string_view(methodStart, position - methodStart);
+			return true;
+		}
+		else if(key == "id" && (*position == '-' || (*position >= '0' && *position <= '9')))
+		{
+			auto result = std::from_chars(position, end, id);
+			if(result.ec != std::errc()) return false;
+			idFound = true;
+			return true;
+		}
+
+		//Skip the value
+		uint32_t depth = 0;
+		bool inString = false;
+		for(; position < end; position++)
+		{
+			char c = *position;
+			if(inString)
+			{
+				if(c == '\\') position++;
+				else if(c == '"')
+				{
+					inString = false;
+					if(depth == 0)
+					{
+						position++;
+						break;
+					}
+				}
+			}
+			else if(c == '"') inString = true;
+			else if(c == '{' || c == '[') depth++;
+			else if(c == '}' || c == ']')
+			{
+				if(depth == 0) break;
+				depth--;
+				if(depth == 0)
+				{
+					position++;
+					break;
+				}
+			}
+			else if(c == ',' && depth == 0) break;
+		}
+
+		skipWhitespace();
+		if(position >= end) return false;
+		if(*position == ',')
+		{
+			position++;
+			continue;
+		}
+		if(*position == '}') return true;
+		return false;
+	}
+}
+
+}
@@ -0,0 +1,156 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODIJSONDOCUMENT_H_
+#define KODIJSONDOCUMENT_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Kodi
+{
+
+/**
+ * Compact JSON DOM for messages received from Kodi. All nodes of a message are stored in one contiguous vector which keeps its
+ * capacity between messages, so parsing a message usually does not allocate at all. Keys and values are views into the parsed
+ * data, which therefore must stay valid as long as the document is used. Conversion to BaseLib::Variable only happens on
+ * request.
+ */
+class KodiJsonDocument
+{
+public:
+	enum class Type : uint8_t
+	{
+		null,
+		boolean,
+		number,
+		string,
+		array,
+		object
+	};
+
+	static constexpr uint32_t npos = 0xFFFFFFFF;
+
+	struct Node
+	{
+		Type type = Type::null;
+
+		/**
+		 * True when a string value contains escape sequences.
+		 */
+		bool escaped = false;
+		uint32_t firstChild = npos;
+		uint32_t nextSibling = npos;
+
+		/**
+		 * The key of object members, raw (not unescaped).
+		 */
+		std::string_view key;
+
+		/**
+		 * The raw text of numbers, booleans and strings (without quotes).
+		 */
+		std::string_view value;
+	};
+
+	KodiJsonDocument() = default;
+	virtual ~KodiJsonDocument() = default;
+
+	/**
+	 * Parses a complete JSON value. All nodes of the previous message are released.
+	 *
+	 * @return Returns false when the data is not valid JSON.
+	 */
+	bool parse(const char* data, size_t size);
+
+	void clear() { _nodes.clear(); }
+	bool empty() const { return _nodes.empty(); }
+	size_t nodeCount() const { return _nodes.size(); }
+
+	/**
+	 * @return Returns the index of the root node or npos when the document is empty.
+	 */
+	uint32_t root() const { return _nodes.empty() ? npos : 0; }
+	const Node& node(uint32_t index) const { return _nodes[index]; }
+
+	/**
+	 * @return Returns the index of the member "key" of an object or npos.
+	 */
+	uint32_t find(uint32_t object, std::string_view key) const;
+
+	/**
+	 * Walks "keyPath" starting at the root object.
+	 *
+	 * @return Returns the index of the node or npos.
+	 */
+	uint32_t find(const std::vector<std::string>& keyPath) const;
+
+	/**
+	 * @return Returns the unescaped string value of a node.
+	 */
+	std::string getString(uint32_t index) const;
+
+	/**
+	 * @return Returns the integer value of a number or boolean node.
+	 */
+	int64_t getInteger(uint32_t index) const;
+
+	/**
+	 * Converts a node and all of its children to a BaseLib::Variable.
+	 */
+	BaseLib::PVariable toVariable(uint32_t index) const;
+
+	/**
+	 * Scans the top level members of a JSON object for "method" and "id" without parsing the message. Scanning stops at the
+	 * first of the two.
+	 *
+	 * @param[out] method The raw method name or an empty view.
+	 * @param[out] id The numeric id.
+	 * @param[out] idFound Set to true when a numeric id was found.
+	 * @return Returns false when the message could not be scanned (invalid JSON or escaped keys). It must be parsed completely then.
+	 */
+	static bool sniff(const char* data, size_t size, std::string_view& method, int64_t& id, bool& idFound);
+private:
+	std::vector<Node> _nodes;
+	const char* _position = nullptr;
+	const char* _end = nullptr;
+
+	void skipWhitespace();
+	bool parseValue(uint32_t index, uint32_t depth);
+	bool parseString(std::string_view& value, bool& escaped);
+	static void appendUtf8(std::string& target, uint32_t codePoint);
+};
+
+}
+
+#endif
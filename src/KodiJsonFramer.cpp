@@ -0,0 +1,288 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiJsonFramer.h"
+#include "KodiJsonDocument.h"
+
+#include <cstring>
+
+namespace Kodi
+{
+
+KodiJsonFramer::KodiJsonFramer(size_t maxFrameSize) : _maxFrameSize(maxFrameSize)
+{
+	_buffer.resize(4096);
+	_mask = _buffer.size() - 1;
+
+	//The buffer size must be a power of two. Allow one maximum sized frame plus room for the start of the next frame.
+	_maxBufferSize = _buffer.size();
+	while(_maxBufferSize < _maxFrameSize + 65536) _maxBufferSize *= 2;
+}
+
+void KodiJsonFramer::reset()
+{
+	_head = 0;
+	_tail = 0;
+	_scanPosition = 0;
+	_inFrame = false;
+	_skipping = false;
+	_inString = false;
+	_escape = false;
+	_depth = 0;
+	_headerChecked = false;
+	_streaming = false;
+	_streamDepth = 0;
+}
+
+void KodiJsonFramer::setStreamCallbacks(std::function<bool(int64_t id)> selectCallback, std::function<void(int64_t id, const char* element, size_t size)> elementCallback, std::function<void(int64_t id, bool complete)> endCallback)
+{
+	_streamSelectCallback = std::move(selectCallback);
+	_streamElementCallback = std::move(elementCallback);
+	_streamEndCallback = std::move(endCallback);
+}
+
+void KodiJsonFramer::deliver(uint64_t start, uint64_t end, const std::function<void(const char* data, size_t size)>& callback)
+{
+	size_t size = end - start;
+	size_t startIndex = start & _mask;
+	if(startIndex + size <= _buffer.size()) callback(_buffer.data() + startIndex, size);
+	else
+	{
+		//Only data wrapping around the end of the buffer is copied.
+		_scratch.resize(size);
+		size_t firstPart = _buffer.size() - startIndex;
+		std::memcpy(_scratch.data(), _buffer.data() + startIndex, firstPart);
+		std::memcpy(_scratch.data() + firstPart, _buffer.data(), size - firstPart);
+		callback(_scratch.data(), size);
+	}
+}
+
+void KodiJsonFramer::checkHeader()
+{
+	//Called at the first top level comma of an object. Only short first members can be an id.
+	_headerChecked = true;
+	if(!_streamSelectCallback || !_frameIsObject) return;
+	size_t size = _scanPosition - _head;
+	if(size > 64) return;
+
+	std::string header(size, 0);
+	for(uint64_t position = _head; position < _scanPosition; position++)
+	{
+		header[position - _head] = _buffer[position & _mask];
+	}
+	std::string_view method;
+	int64_t id = 0;
+	bool idFound = false;
+	if(!KodiJsonDocument::sniff(header.data(), header.size(), method, id, idFound) || !idFound) return;
+	if(!_streamSelectCallback(id)) return;
+
+	_streaming = true;
+	_streamId = id;
+	_streamDepth = 0;
+	_head = _scanPosition + 1;
+}
+
+void KodiJsonFramer::processStreamed(char c)
+{
+	//The depth was already updated for "c". Bytes outside of array elements are dropped immediately.
+	if(_inString) return;
+	if(_streamDepth == 0)
+	{
+		if(c == '[' && _depth >= 2) _streamDepth = _depth;
+		_head = _scanPosition + 1;
+		return;
+	}
+	if(_streamDepth == -1)
+	{
+		_head = _scanPosition + 1;
+		return;
+	}
+
+	bool elementEnd = (c == ',' && (int32_t)_depth == _streamDepth);
+	bool arrayEnd = (c == ']' && (int32_t)_depth == _streamDepth - 1);
+	if(!elementEnd && !arrayEnd) return;
+
+	uint64_t start = _head;
+	uint64_t end = _scanPosition;
+	auto isWhitespace = [](char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; };
+	while(start < end && isWhitespace(_buffer[start & _mask])) start++;
+	while(end > start && isWhitespace(_buffer[(end - 1) & _mask])) end--;
+	if(end > start && _streamElementCallback)
+	{
+		int64_t id = _streamId;
+		deliver(start, end, [&](const char* data, size_t size) { _streamElementCallback(id, data, size); });
+	}
+	_head = _scanPosition + 1;
+	if(arrayEnd) _streamDepth = -1;
+}
+
+void KodiJsonFramer::resize(size_t size)
+{
+	std::vector<char> newBuffer(size);
+	size_t newMask = newBuffer.size() - 1;
+	//Keep the positions, only the index changes.
+	for(uint64_t position = _head; position < _tail; position++)
+	{
+		newBuffer[position & newMask] = _buffer[position & _mask];
+	}
+	_buffer.swap(newBuffer);
+	_mask = newMask;
+}
+
+void KodiJsonFramer::grow()
+{
+	resize(_buffer.size() * 2);
+}
+
+void KodiJsonFramer::shrink()
+{
+	size_t size = 4096;
+	while(size < (_tail - _head) * 2) size *= 2;
+	if(size * 4 <= _buffer.size()) resize(size);
+}
+
+void KodiJsonFramer::resync()
+{
+	if((_inFrame && !_skipping) || _scanPosition != _tail)
+	{
+		_skippedFrames++;
+		if(_streaming)
+		{
+			_streaming = false;
+			if(_streamEndCallback) _streamEndCallback(_streamId, false);
+		}
+	}
+	if(_scanPosition == _tail) _skipping = _inFrame;
+	else
+	{
+		_inFrame = false;
+		_skipping = false;
+		_inString = false;
+		_escape = false;
+		_depth = 0;
+	}
+	_head = _tail;
+	_scanPosition = _tail;
+}
+
+char* KodiJsonFramer::getWriteBuffer(size_t& size)
+{
+	if(_tail - _head == _buffer.size())
+	{
+		if(_buffer.size() < _maxBufferSize) grow();
+		else resync();
+	}
+
+	size_t tailIndex = _tail & _mask;
+	size_t headIndex = _head & _mask;
+	if(tailIndex >= headIndex) size = _buffer.size() - tailIndex;
+	else size = headIndex - tailIndex;
+	return _buffer.data() + tailIndex;
+}
+
+void KodiJsonFramer::commit(size_t size)
+{
+	_tail += size;
+}
+
+void KodiJsonFramer::process(const std::function<void(const char* frame, size_t size)>& frameCallback)
+{
+	for(; _scanPosition < _tail; _scanPosition++)
+	{
+		char c = _buffer[_scanPosition & _mask];
+		if(!_inFrame)
+		{
+			//Skip whitespace and garbage between frames.
+			if(c != '{' && c != '[')
+			{
+				_head = _scanPosition + 1;
+				continue;
+			}
+			_inFrame = true;
+			_frameIsObject = (c == '{');
+			_headerChecked = false;
+			_depth = 1;
+			_head = _scanPosition;
+			continue;
+		}
+
+		if(_inString)
+		{
+			if(_escape) _escape = false;
+			else if(c == '\\') _escape = true;
+			else if(c == '"') _inString = false;
+		}
+		else if(c == '"') _inString = true;
+		else if(c == '{' || c == '[') _depth++;
+		else if(c == '}' || c == ']') _depth--;
+
+		if(_depth == 0)
+		{
+			uint64_t frameEnd = _scanPosition + 1;
+			_inFrame = false;
+			if(_streaming)
+			{
+				_streaming = false;
+				_head = frameEnd;
+				if(_streamEndCallback) _streamEndCallback(_streamId, true);
+				continue;
+			}
+			if(_skipping)
+			{
+				_skipping = false;
+				_head = frameEnd;
+				continue;
+			}
+
+			deliver(_head, frameEnd, frameCallback);
+			_head = frameEnd;
+		}
+		else if(_skipping) _head = _scanPosition + 1;
+		else
+		{
+			if(!_headerChecked && !_inString && _depth == 1 && c == ',') checkHeader();
+			else if(_streaming) processStreamed(c);
+
+			if(_scanPosition + 1 - _head > _maxFrameSize)
+			{
+				//Drop the frame, but keep scanning it to find its end.
+				_skipping = true;
+				_skippedFrames++;
+				_head = _scanPosition + 1;
+				if(_streaming)
+				{
+					_streaming = false;
+					if(_streamEndCallback) _streamEndCallback(_streamId, false);
+				}
+			}
+		}
+	}
+}
+
+}
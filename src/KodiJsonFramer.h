@@ -0,0 +1,152 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODIJSONFRAMER_H_
+#define KODIJSONFRAMER_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Kodi
+{
+
+/**
+ * Splits the TCP stream from Kodi into JSON objects or arrays. Received data is written directly into a ring buffer and every
+ * byte is scanned exactly once, so leftover data is never copied. Frames not wrapping around the end of the ring buffer are
+ * handed to the callback in place.
+ */
+class KodiJsonFramer
+{
+public:
+	/**
+	 * @param maxFrameSize Frames larger than this are skipped.
+	 */
+	explicit KodiJsonFramer(size_t maxFrameSize = 1000000);
+	virtual ~KodiJsonFramer() = default;
+
+	/**
+	 * Discards all buffered data and the scan state. Call this when the connection is reestablished.
+	 */
+	void reset();
+
+	/**
+	 * Returns the contiguous free region at the end of the ring buffer. The buffer grows when it is full, but not beyond the maximum
+	 * frame size plus some headroom. When the buffer is full at that size, the buffered data is dropped and the framer resynchronizes.
+	 *
+	 * @param[out] size The number of bytes that can be written.
+	 * @return Returns a pointer to the free region.
+	 */
+	char* getWriteBuffer(size_t& size);
+
+	/**
+	 * Marks "size" bytes written to the region returned by getWriteBuffer() as received.
+	 */
+	void commit(size_t size);
+
+	/**
+	 * Scans all received data and calls "frameCallback" for every complete frame. The frame data is only valid during the
+	 * callback.
+	 */
+	void process(const std::function<void(const char* frame, size_t size)>& frameCallback);
+
+	/**
+	 * Releases memory after large frames. The ring buffer is reduced to its initial size or twice the buffered data, whichever is
+	 * larger. Does nothing while most of the buffer is in use.
+	 */
+	void shrink();
+
+	/**
+	 * Enables streaming of large responses. When the first member of a frame is a numeric "id" and "selectCallback" returns
+	 * true for it, the frame is not buffered as a whole. Instead every element of the first array within the response is handed
+	 * to "elementCallback" as soon as it is complete and removed from the buffer. So the buffer only needs to hold one element
+	 * and "maxFrameSize" applies to single elements. "endCallback" is called when the frame is complete or when streaming was
+	 * aborted, because an element exceeded the maximum frame size.
+	 */
+	void setStreamCallbacks(std::function<bool(int64_t id)> selectCallback, std::function<void(int64_t id, const char* element, size_t size)> elementCallback, std::function<void(int64_t id, bool complete)> endCallback);
+
+	/**
+	 * @return Returns the number of frames skipped because they exceeded the maximum frame size.
+	 */
+	uint64_t skippedFrames() { return _skippedFrames; }
+
+	size_t bufferedBytes() { return _tail - _head; }
+private:
+	size_t _maxFrameSize = 1000000;
+	size_t _maxBufferSize = 0;
+	std::vector<char> _buffer;
+	size_t _mask = 0;
+	std::vector<char> _scratch;
+
+	//Positions are counted from the start of the stream. The index into _buffer is "position & _mask".
+	uint64_t _head = 0;
+	uint64_t _tail = 0;
+	uint64_t _scanPosition = 0;
+
+	bool _inFrame = false;
+	bool _skipping = false;
+	bool _inString = false;
+	bool _escape = false;
+	uint32_t _depth = 0;
+	uint64_t _skippedFrames = 0;
+
+	//{{{ Streaming
+	std::function<bool(int64_t id)> _streamSelectCallback;
+	std::function<void(int64_t id, const char* element, size_t size)> _streamElementCallback;
+	std::function<void(int64_t id, bool complete)> _streamEndCallback;
+	bool _frameIsObject = false;
+	bool _headerChecked = false;
+	bool _streaming = false;
+	int64_t _streamId = 0;
+
+	//The depth of the streamed array. "0" while it was not found yet, "-1" after it was closed.
+	int32_t _streamDepth = 0;
+	//}}}
+
+	void grow();
+	void resize(size_t size);
+
+	/**
+	 * Drops all buffered data. A frame in progress is counted as skipped. When all buffered data was scanned, the rest of the frame is
+	 * skipped. Otherwise the scan state is unknown and scanning restarts at the next "{" or "[".
+	 */
+	void resync();
+
+	/**
+	 * Hands the data between "start" and "end" to "callback". Copies the data when it wraps around the end of the buffer.
+	 */
+	void deliver(uint64_t start, uint64_t end, const std::function<void(const char* data, size_t size)>& callback);
+	void checkHeader();
+	void processStreamed(char c);
+};
+
+}
+
+#endif
@@ -0,0 +1,101 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiMethodSet.h"
+
+#include <algorithm>
+
+namespace Kodi
+{
+
+KodiMethodSet::KodiMethodSet(const std::vector<std::string>& methods)
+{
+	std::vector<std::string> uniqueMethods;
+	uniqueMethods.reserve(methods.size());
+	for(auto& method : methods)
+	{
+		if(!method.empty() && std::find(uniqueMethods.begin(), uniqueMethods.end(), method) == uniqueMethods.end()) uniqueMethods.push_back(method);
+	}
+	if(uniqueMethods.empty()) return;
+
+	//Try a number of seeds per table size. With at least twice as many slots as methods a seed is usually found quickly.
+	uint32_t slotCount = 1;
+	while(slotCount < uniqueMethods.size() * 2) slotCount <<= 1;
+	std::vector<bool> used;
+	while(true)
+	{
+		for(uint32_t seed = 1; seed <= 1000; seed++)
+		{
+			used.assign(slotCount, false);
+			bool collision = false;
+			for(auto& method : uniqueMethods)
+			{
+				uint32_t slot = hash(method, seed) & (slotCount - 1);
+				if(used[slot])
+				{
+					collision = true;
+					break;
+				}
+				used[slot] = true;
+			}
+			if(collision) continue;
+
+			_slots.assign(slotCount, std::string());
+			_mask = slotCount - 1;
+			_seed = seed;
+			_size = uniqueMethods.size();
+			for(auto& method : uniqueMethods)
+			{
+				_slots[hash(method, seed) & _mask] = method;
+			}
+			return;
+		}
+		slotCount <<= 1;
+	}
+}
+
+uint32_t KodiMethodSet::hash(std::string_view value, uint32_t seed)
+{
+	//FNV-1a with the seed mixed into the offset basis
+	uint32_t result = 2166136261u ^ (seed * 16777619u);
+	for(char c : value)
+	{
+		result ^= (uint8_t)c;
+		result *= 16777619u;
+	}
+	return result ^ (result >> 15);
+}
+
+bool KodiMethodSet::contains(std::string_view method) const
+{
+	if(_slots.empty() || method.empty()) return false;
+	return _slots[hash(method, _seed) & _mask] == method;
+}
+
+}
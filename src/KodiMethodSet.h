@@ -0,0 +1,66 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODIMETHODSET_H_
+#define KODIMETHODSET_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Kodi
+{
+
+/**
+ * Immutable set of method names with a perfect hash. The seed of the hash function is searched when the set is created, so
+ * every method occupies its own slot and a lookup costs one hash and at most one string comparison.
+ */
+class KodiMethodSet
+{
+public:
+	KodiMethodSet() = default;
+	explicit KodiMethodSet(const std::vector<std::string>& methods);
+	virtual ~KodiMethodSet() = default;
+
+	bool contains(std::string_view method) const;
+	size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+private:
+	std::vector<std::string> _slots;
+	uint32_t _mask = 0;
+	uint32_t _seed = 0;
+	size_t _size = 0;
+
+	static uint32_t hash(std::string_view value, uint32_t seed);
+};
+
+}
+
+#endif
@@ -55,6 +55,15 @@ KodiPacket::KodiPacket(std::string method, BaseLib::PVariable parameters, int64_
 	_parameters = parameters;
 }
 
+KodiPacket::KodiPacket(const KodiJsonDocument& document, uint32_t index, int64_t timeReceived)
+{
+	_timeReceived = timeReceived;
+	_document = &document;
+	_index = index;
+	uint32_t methodIndex = document.find(index, "method");
+	if(methodIndex != KodiJsonDocument::npos) _method = document.getString(methodIndex);
+}
+
 KodiPacket::~KodiPacket()
 {
 }
@@ -66,14 +75,48 @@ std::string KodiPacket::getMethod()
 
 BaseLib::PVariable KodiPacket::getParameters()
 {
+	if(!_parameters && _document) _parameters = _document->toVariable(_document->find(_index, "params"));
 	return _parameters;
 }
 
 BaseLib::PVariable KodiPacket::getResult()
 {
+	if(!_result && _document) _result = _document->toVariable(_document->find(_index, "result"));
 	return _result;
 }
 
+BaseLib::PVariable KodiPacket::getValue(const std::vector<std::string>& keyPath)
+{
+	try
+	{
+		if(_document)
+		{
+			uint32_t index = _index;
+			for(auto& key : keyPath)
+			{
+				index = _document->find(index, key);
+				if(index == KodiJsonDocument::npos) return BaseLib::PVariable();
+			}
+			return _document->toVariable(index);
+		}
+
+		BaseLib::PVariable value = getJson();
+		if(!value) return BaseLib::PVariable();
+		for(auto& key : keyPath)
+		{
+			BaseLib::Struct::iterator jsonValueIterator = value->structValue->find(key);
+			if(jsonValueIterator == value->structValue->end() || !jsonValueIterator->second) return BaseLib::PVariable();
+			value = jsonValueIterator->second;
+		}
+		return value;
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return BaseLib::PVariable();
+}
+
 BaseLib::PVariable KodiPacket::getJson()
 {
 	try
@@ -81,7 +124,7 @@ BaseLib::PVariable KodiPacket::getJson()
 		BaseLib::PVariable json(new BaseLib::Variable(BaseLib::VariableType::tStruct));
 		json->structValue->insert(BaseLib::StructElement("jsonrpc", BaseLib::PVariable(new BaseLib::Variable(std::string("2.0")))));
 		json->structValue->insert(BaseLib::StructElement("method", BaseLib::PVariable(new BaseLib::Variable(_method))));
-		json->structValue->insert(BaseLib::StructElement("params", _parameters));
+		json->structValue->insert(BaseLib::StructElement("params", getParameters()));
 		return json;
 	}
 	catch(const std::exception& ex)
@@ -33,6 +33,7 @@
 #include <cstdint>
 
 #include <homegear-base/BaseLib.h>
+#include "KodiJsonDocument.h"
 
 namespace Kodi
 {
@@ -44,6 +45,15 @@ class KodiPacket : public BaseLib::Systems::Packet
         KodiPacket();
         KodiPacket(BaseLib::PVariable& json, int64_t timeReceived = 0);
         KodiPacket(std::string method, BaseLib::PVariable parameters, int64_t timeReceived = 0);
+
+        /**
+         * Creates a packet backed by a parsed message. Values are only converted when requested. The packet must not be used
+         * after the document was reused for the next message.
+         *
+         * @param document The parsed message.
+         * @param index The index of the message object within the document.
+         */
+        KodiPacket(const KodiJsonDocument& document, uint32_t index, int64_t timeReceived = 0);
         virtual ~KodiPacket();
 
         virtual BaseLib::PVariable getJson();
@@ -51,10 +61,19 @@ class KodiPacket : public BaseLib::Systems::Packet
         std::string getMethod();
         BaseLib::PVariable getParameters();
         BaseLib::PVariable getResult();
+
+        /**
+         * Walks "keyPath" starting at the message object (e. g. "params", "data", "volume").
+         *
+         * @return Returns the value or nullptr when the key path does not exist.
+         */
+        BaseLib::PVariable getValue(const std::vector<std::string>& keyPath);
     protected:
         std::string _method;
         BaseLib::PVariable _parameters;
         BaseLib::PVariable _result;
+        const KodiJsonDocument* _document = nullptr;
+        uint32_t _index = KodiJsonDocument::npos;
 };
 
 }
@@ -33,6 +33,7 @@
 #include "KodiPacket.h"
 #include "KodiCentral.h"
 
+#include <cmath>
 #include <iomanip>
 
 namespace Kodi
@@ -80,8 +81,6 @@ void KodiPeer::init()
 	{
 		_binaryEncoder.reset(new BaseLib::Rpc::RpcEncoder(GD::bl));
 		_binaryDecoder.reset(new BaseLib::Rpc::RpcDecoder(GD::bl));
-		_interface.setPacketReceivedCallback(std::bind(&KodiPeer::packetReceived, this, std::placeholders::_1));
-		_interface.setConnectedCallback(std::bind(&KodiPeer::connected, this, std::placeholders::_1));
 	}
 	catch(const std::exception& ex)
 	{
@@ -92,7 +91,15 @@ void KodiPeer::init()
 void KodiPeer::dispose()
 {
 	if(_disposing) return;
+	//Stop everything producing new values first. Peer::dispose() sets "_disposing", so saveVariable() doesn't queue values anymore.
+	disconnectInterface();
+	stopCoalescing();
 	Peer::dispose();
+	if(GD::persistence)
+	{
+		GD::persistence->flush(_peerID);
+		GD::persistence->discard(_peerID);
+	}
 }
 
 void KodiPeer::homegearStarted()
@@ -112,6 +119,7 @@ void KodiPeer::homegearShuttingDown()
 	try
 	{
 		_shuttingDown = true;
+		if(GD::persistence) GD::persistence->flush(_peerID);
 		Peer::homegearShuttingDown();
 	}
 	catch(const std::exception& ex)
@@ -133,6 +141,10 @@ std::string KodiPeer::handleCliCommand(std::string command)
 			stringStream << "unselect\t\tUnselect this peer" << std::endl;
 			stringStream << "channel count\t\tPrint the number of channels of this peer" << std::endl;
 			stringStream << "config print\t\tPrints all configuration parameters and their values" << std::endl;
+			stringStream << "queue status\t\tPrints the state of the outbound queue" << std::endl;
+			stringStream << "notifications dropped\tPrints the number of dropped notifications by method" << std::endl;
+			stringStream << "stats\t\t\tPrints the transport metrics of the connection to Kodi" << std::endl;
+			stringStream << "capture\t\t\tRecords the traffic with Kodi or replays a recording" << std::endl;
 			return stringStream.str();
 		}
 		if(command.compare(0, 13, "channel count") == 0)
@@ -192,6 +204,174 @@ std::string KodiPeer::handleCliCommand(std::string command)
 
 			return printConfig();
 		}
+		else if(command.compare(0, 12, "queue status") == 0)
+		{
+			std::stringstream stream(command);
+			std::string element;
+			int32_t index = 0;
+			while(std::getline(stream, element, ' '))
+			{
+				if(index < 2)
+				{
+					index++;
+					continue;
+				}
+				else if(index == 2)
+				{
+					if(element == "help")
+					{
+						stringStream << "Description: This command prints the number of queued, in-flight and dropped requests of this peer." << std::endl;
+						stringStream << "Usage: queue status" << std::endl << std::endl;
+						stringStream << "Parameters:" << std::endl;
+						stringStream << "  There are no parameters." << std::endl;
+						return stringStream.str();
+					}
+				}
+				index++;
+			}
+
+			std::shared_ptr<KodiInterface> interface = getInterface();
+			if(!interface) return "Peer has no interface.\n";
+			stringStream << "Queued requests:    " << interface->getQueuedRequestCount() << std::endl;
+			stringStream << "In-flight requests: " << interface->getInFlightRequestCount() << std::endl;
+			stringStream << "Dropped requests:   " << interface->getDroppedRequestCount() << std::endl;
+			return stringStream.str();
+		}
+		else if(command.compare(0, 21, "notifications dropped") == 0)
+		{
+			std::stringstream stream(command);
+			std::string element;
+			int32_t index = 0;
+			while(std::getline(stream, element, ' '))
+			{
+				if(index < 2)
+				{
+					index++;
+					continue;
+				}
+				else if(index == 2)
+				{
+					if(element == "help")
+					{
+						stringStream << "Description: This command prints the number of notifications dropped before decoding, because no packet of this peer handles them." << std::endl;
+						stringStream << "Usage: notifications dropped" << std::endl << std::endl;
+						stringStream << "Parameters:" << std::endl;
+						stringStream << "  There are no parameters." << std::endl;
+						return stringStream.str();
+					}
+				}
+				index++;
+			}
+
+			std::shared_ptr<KodiInterface> interface = getInterface();
+			if(!interface) return "Peer has no interface.\n";
+			std::map<std::string, uint64_t> droppedNotifications = interface->getDroppedNotifications();
+			for(auto& droppedNotification : droppedNotifications)
+			{
+				stringStream << droppedNotification.first << ": " << droppedNotification.second << std::endl;
+			}
+			stringStream << "Unmatched responses: " << interface->getUnmatchedResponseCount() << std::endl;
+			stringStream << "Queue overflows:     " << interface->getOverflowedNotificationCount() << std::endl;
+			return stringStream.str();
+		}
+		else if(command.compare(0, 5, "stats") == 0)
+		{
+			std::stringstream stream(command);
+			std::string element;
+			int32_t index = 0;
+			while(std::getline(stream, element, ' '))
+			{
+				if(index < 1)
+				{
+					index++;
+					continue;
+				}
+				else if(index == 1)
+				{
+					if(element == "help")
+					{
+						stringStream << "Description: This command prints the transport metrics of the connection to Kodi and the number of values ignored by the change filter and events merged by the coalescing window of this peer. The connection might be shared with other peers. Decode times are in microseconds, request times in milliseconds." << std::endl;
+						stringStream << "Usage: stats" << std::endl << std::endl;
+						stringStream << "Parameters:" << std::endl;
+						stringStream << "  There are no parameters." << std::endl;
+						return stringStream.str();
+					}
+				}
+				index++;
+			}
+
+			std::shared_ptr<KodiInterface> interface = getInterface();
+			if(!interface) return "Peer has no interface.\n";
+			return KodiInterface::printMetrics(interface->getMetrics()) + "Unchanged values ignored: " + std::to_string(_suppressedValues.load()) + "\nEvents merged: " + std::to_string(_coalescedEvents.load()) + "\n";
+		}
+		else if(command.compare(0, 7, "capture") == 0)
+		{
+			std::string action;
+			std::string path;
+			bool fast = false;
+			std::stringstream stream(command);
+			std::string element;
+			int32_t index = 0;
+			while(std::getline(stream, element, ' '))
+			{
+				if(index < 1)
+				{
+					index++;
+					continue;
+				}
+				else if(index == 1) action = element;
+				else if(index == 2) path = element;
+				else if(index == 3) fast = (element == "fast");
+				index++;
+			}
+			if(action.empty() || action == "help" || ((action == "start" || action == "replay") && path.empty()))
+			{
+				stringStream << "Description: This command records all data sent to and received from Kodi with timestamps to a binary file or feeds a recording through the receive path of this peer. During replay the peer's variables are updated as if the data was received from Kodi." << std::endl;
+				stringStream << "Usage: capture start FILE" << std::endl;
+				stringStream << "       capture stop" << std::endl;
+				stringStream << "       capture replay FILE [fast]" << std::endl << std::endl;
+				stringStream << "Parameters:" << std::endl;
+				stringStream << "  FILE:\tThe path of the capture file. Example: /tmp/kodi.cap" << std::endl;
+				stringStream << "  fast:\tReplay as fast as possible instead of with the recorded timing." << std::endl;
+				return stringStream.str();
+			}
+
+			if(action == "replay")
+			{
+				//The recording is replayed through a separate interface, so the connection to Kodi is not affected.
+				std::shared_ptr<KodiInterface> replayInterface = std::make_shared<KodiInterface>();
+				KodiInterface::Subscriber subscriber = createSubscriber();
+				subscriber.connected = nullptr;
+				subscriber.reconnectScheduled = nullptr;
+				subscriber.roundTripMeasured = nullptr;
+				replayInterface->subscribe(subscriber);
+				PVariable result = replayInterface->replay(path, !fast);
+				replayInterface->unsubscribe(subscriber.id);
+				if(result->errorStruct) return "Error: " + result->structValue->at("faultString")->stringValue + "\n";
+				stringStream << "Records:  " << result->structValue->at("records")->integerValue64 << std::endl;
+				stringStream << "Bytes:    " << result->structValue->at("bytes")->integerValue64 << std::endl;
+				stringStream << "Frames:   " << result->structValue->at("frames")->integerValue64 << std::endl;
+				stringStream << "Duration: " << result->structValue->at("duration")->integerValue64 << " us" << std::endl;
+				stringStream << KodiInterface::printMetrics(replayInterface->getMetrics());
+				return stringStream.str();
+			}
+
+			std::shared_ptr<KodiInterface> interface = getInterface();
+			if(!interface) return "Peer has no interface.\n";
+			if(action == "start")
+			{
+				if(!interface->startCapture(path)) return "Could not create capture file.\n";
+				stringStream << "Capturing to " << path << ". The connection might be shared with other peers, so their traffic is recorded as well." << std::endl;
+				return stringStream.str();
+			}
+			else if(action == "stop")
+			{
+				if(!interface->isCapturing()) return "No capture is running.\n";
+				interface->stopCapture();
+				return "Capture stopped.\n";
+			}
+			return "Unknown action.\n";
+		}
 		else return "Unknown command.\n";
 	}
 	catch(const std::exception& ex)
@@ -285,31 +465,225 @@ bool KodiPeer::load(BaseLib::Systems::ICentral* central)
 			return false;
 		}
 		initializeTypeString();
+		compileDeviceDescription();
+		initializeEventMetadata();
 		std::string entry;
 		loadConfig();
 		initializeCentralConfig();
 
 		serviceMessages.reset(new BaseLib::Systems::ServiceMessages(_bl, _peerID, _serialNumber, this));
 		serviceMessages->load();
+		loadChangeFilter();
+
+		BaseLib::PVariable hostname = getConfigValue(0, "HOSTNAME");
+		BaseLib::PVariable port = getConfigValue(0, "PORT");
+		if(hostname && port) connectInterface(hostname->stringValue, port->integerValue);
+
+		return true;
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    return false;
+}
+
+void KodiPeer::compileDeviceDescription()
+{
+	compileRequestTemplates();
+	compileNotificationTable();
+}
+
+void KodiPeer::initializeEventMetadata()
+{
+	try
+	{
+		_eventSource = "device-" + std::to_string(_peerID);
+		_channelAddresses.clear();
+		if(!_rpcDevice) return;
+		for(Functions::iterator i = _rpcDevice->functions.begin(); i != _rpcDevice->functions.end(); ++i)
+		{
+			_channelAddresses.emplace(i->first, _serialNumber + ":" + std::to_string(i->first));
+		}
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
+std::string& KodiPeer::getChannelAddress(uint32_t channel)
+{
+	std::unordered_map<uint32_t, std::string>::iterator addressIterator = _channelAddresses.find(channel);
+	if(addressIterator != _channelAddresses.end()) return addressIterator->second;
+	//Not reached for channels of the device description.
+	thread_local std::string address;
+	address = _serialNumber + ":" + std::to_string(channel);
+	return address;
+}
+
+void KodiPeer::compileRequestTemplates()
+{
+	try
+	{
+		_requestTemplates.clear();
+		if(!_rpcDevice) return;
+		for(PacketsById::iterator i = _rpcDevice->packetsById.begin(); i != _rpcDevice->packetsById.end(); ++i)
+		{
+			if(i->second->direction == Packet::Direction::Enum::toCentral || i->second->function1.empty()) continue;
+			_requestTemplates.emplace(i->first, KodiRequestTemplate(i->second));
+		}
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
+void KodiPeer::compileNotificationTable()
+{
+	try
+	{
+		_notificationTable.clear();
+		if(!_rpcDevice) return;
+		for(PacketsByFunction::iterator i = _rpcDevice->packetsByFunction1.begin(); i != _rpcDevice->packetsByFunction1.end(); ++i)
+		{
+			PPacket frame(i->second);
+			if(!frame || frame->direction != Packet::Direction::Enum::toCentral) continue;
+
+			int32_t startChannel = (frame->channel < 0) ? 0 : frame->channel;
+			int32_t endChannel = startChannel;
+			//When fixedChannel is -2 (means '*') cycle through all channels
+			if(frame->channel == -2 && !_rpcDevice->functions.empty()) endChannel = _rpcDevice->functions.rbegin()->first;
+
+			NotificationFrame notificationFrame;
+			notificationFrame.frameId = frame->id;
+			for(JsonPayloads::iterator j = frame->jsonPayloads.begin(); j != frame->jsonPayloads.end(); ++j)
+			{
+				NotificationBinding binding;
+				if((*j)->constValueBooleanSet) binding.constValue = std::make_shared<BaseLib::Variable>((*j)->constValueBoolean);
+				else if((*j)->constValueIntegerSet) binding.constValue = std::make_shared<BaseLib::Variable>((*j)->constValueInteger);
+				else if((*j)->constValueDecimalSet) binding.constValue = std::make_shared<BaseLib::Variable>((*j)->constValueDecimal);
+				else if((*j)->constValueStringSet) binding.constValue = std::make_shared<BaseLib::Variable>((*j)->constValueString);
+				else binding.keyPath = (*j)->keyPath;
+
+				for(std::vector<PParameter>::iterator k = frame->associatedVariables.begin(); k != frame->associatedVariables.end(); ++k)
+				{
+					if((*k)->physical->groupId != (*j)->parameterId) continue;
+					NotificationTarget target;
+					target.parameter = *k;
+					target.parameterSetType = (*k)->parent()->type();
+					target.converter = KodiValueConverter(*k);
+					for(int32_t l = startChannel; l <= endChannel; l++)
+					{
+						Functions::iterator functionIterator = _rpcDevice->functions.find(l);
+						if(functionIterator == _rpcDevice->functions.end()) continue;
+						PParameterGroup parameterGroup = functionIterator->second->getParameterGroup(target.parameterSetType);
+						if(parameterGroup->parameters.find((*k)->id) == parameterGroup->parameters.end()) continue;
+						target.channels.push_back(l);
+					}
+					if(!target.channels.empty()) binding.targets.push_back(std::move(target));
+				}
+				if(!binding.targets.empty()) notificationFrame.bindings.push_back(std::move(binding));
+			}
+			if(!notificationFrame.bindings.empty()) _notificationTable[i->first].push_back(std::move(notificationFrame));
+		}
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
+void KodiPeer::loadChangeFilter()
+{
+	try
+	{
+		std::shared_ptr<ChangeFilter> changeFilter = std::make_shared<ChangeFilter>();
+		BaseLib::PVariable suppressUnchanged = getConfigValue(0, "SUPPRESS_UNCHANGED");
+		if(suppressUnchanged) changeFilter->suppressUnchanged = suppressUnchanged->booleanValue;
 
 		std::unordered_map<uint32_t, std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>>::iterator channelIterator = configCentral.find(0);
 		if(channelIterator != configCentral.end())
 		{
-			std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator hostnameIterator = channelIterator->second.find("HOSTNAME");
-			std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator portIterator = channelIterator->second.find("PORT");
-			if(hostnameIterator != channelIterator->second.end() && portIterator != channelIterator->second.end() && hostnameIterator->second.rpcParameter && portIterator->second.rpcParameter)
+			const std::string suffix = "_DEADBAND";
+			for(std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator i = channelIterator->second.begin(); i != channelIterator->second.end(); ++i)
 			{
-				std::vector<uint8_t> parameterData = hostnameIterator->second.getBinaryData();
-				BaseLib::PVariable hostname = hostnameIterator->second.rpcParameter->convertFromPacket(parameterData, hostnameIterator->second.mainRole(), false);
-				parameterData = portIterator->second.getBinaryData();
-				BaseLib::PVariable port = portIterator->second.rpcParameter->convertFromPacket(parameterData, portIterator->second.mainRole(), false);
-				_interface.setHostname(hostname->stringValue);
-				_interface.setPort(port->integerValue);
-				_interface.startListening();
+				if(i->first.size() <= suffix.size() || i->first.compare(i->first.size() - suffix.size(), suffix.size(), suffix) != 0) continue;
+				BaseLib::PVariable deadband = getConfigValue(0, i->first);
+				if(!deadband) continue;
+				double value = (deadband->type == BaseLib::VariableType::tFloat) ? deadband->floatValue : deadband->integerValue;
+				if(value > 0) changeFilter->deadbands.emplace(i->first.substr(0, i->first.size() - suffix.size()), value);
+			}
+
+			const std::string windowSuffix = "_COALESCE_WINDOW";
+			for(std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator i = channelIterator->second.begin(); i != channelIterator->second.end(); ++i)
+			{
+				if(i->first.size() <= windowSuffix.size() || i->first.compare(i->first.size() - windowSuffix.size(), windowSuffix.size(), windowSuffix) != 0) continue;
+				BaseLib::PVariable window = getConfigValue(0, i->first);
+				if(window) changeFilter->coalesceWindows.emplace(i->first.substr(0, i->first.size() - windowSuffix.size()), window->integerValue);
 			}
 		}
 
-		return true;
+		BaseLib::PVariable coalesceWindow = getConfigValue(0, "COALESCE_WINDOW");
+		if(coalesceWindow) changeFilter->coalesceWindow = coalesceWindow->integerValue;
+		BaseLib::PVariable coalesceBypass = getConfigValue(0, "COALESCE_BYPASS");
+		if(coalesceBypass)
+		{
+			std::stringstream stream(coalesceBypass->stringValue);
+			std::string element;
+			while(std::getline(stream, element, ','))
+			{
+				BaseLib::HelperFunctions::trim(element);
+				if(!element.empty()) changeFilter->coalesceBypass.insert(element);
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> changeFilterGuard(_changeFilterMutex);
+			_changeFilter = changeFilter;
+		}
+		//Windows opened with the old settings would otherwise keep running with their old length, even when merging was disabled.
+		closeCoalesceWindows();
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
+int64_t KodiPeer::ChangeFilter::getCoalesceWindow(const std::string& name) const
+{
+	if(coalesceBypass.find(name) != coalesceBypass.end()) return 0;
+	std::unordered_map<std::string, int64_t>::const_iterator windowIterator = coalesceWindows.find(name);
+	return windowIterator == coalesceWindows.end() ? coalesceWindow : windowIterator->second;
+}
+
+bool KodiPeer::isUnchanged(const ChangeFilter& changeFilter, BaseLib::Systems::RpcConfigurationParameter& parameter, const std::string& name, std::vector<uint8_t>& value)
+{
+	try
+	{
+		if(changeFilter.suppressUnchanged && parameter.equals(value)) return true;
+
+		std::unordered_map<std::string, double>::const_iterator deadbandIterator = changeFilter.deadbands.find(name);
+		if(deadbandIterator == changeFilter.deadbands.end() || !parameter.rpcParameter) return false;
+		std::vector<uint8_t> storedData = parameter.getBinaryData();
+		if(storedData.empty()) return false;
+		BaseLib::PVariable storedValue = parameter.rpcParameter->convertFromPacket(storedData, parameter.mainRole(), false);
+		BaseLib::PVariable newValue = parameter.rpcParameter->convertFromPacket(value, parameter.mainRole(), false);
+		if(!storedValue || !newValue) return false;
+		auto toNumber = [](const BaseLib::PVariable& variable) -> double
+		{
+			if(variable->type == BaseLib::VariableType::tFloat) return variable->floatValue;
+			if(variable->type == BaseLib::VariableType::tInteger64) return variable->integerValue64;
+			return variable->integerValue;
+		};
+		auto isNumber = [](const BaseLib::PVariable& variable)
+		{
+			return variable->type == BaseLib::VariableType::tInteger || variable->type == BaseLib::VariableType::tInteger64 || variable->type == BaseLib::VariableType::tFloat;
+		};
+		if(!isNumber(storedValue) || !isNumber(newValue)) return false;
+		return std::abs(toNumber(newValue) - toNumber(storedValue)) < deadbandIterator->second;
 	}
 	catch(const std::exception& ex)
     {
@@ -318,6 +692,260 @@ bool KodiPeer::load(BaseLib::Systems::ICentral* central)
     return false;
 }
 
+void KodiPeer::coalesceEvents(const ChangeFilter& changeFilter, uint32_t channel, std::shared_ptr<std::vector<std::string>>& valueKeys, std::shared_ptr<std::vector<PVariable>>& values)
+{
+	try
+	{
+		if(!GD::eventLoop || valueKeys->size() != values->size()) return;
+		std::shared_ptr<std::vector<std::string>> keptKeys;
+		std::shared_ptr<std::vector<PVariable>> keptValues;
+		std::lock_guard<std::mutex> coalesceWindowsGuard(_coalesceWindowsMutex);
+		for(size_t i = 0; i < valueKeys->size(); i++)
+		{
+			int64_t window = changeFilter.getCoalesceWindow(valueKeys->at(i));
+			bool keep = true;
+			if(window > 0)
+			{
+				std::pair<uint32_t, std::string> key(channel, valueKeys->at(i));
+				std::map<std::pair<uint32_t, std::string>, CoalesceWindow>::iterator windowIterator = _coalesceWindows.find(key);
+				if(windowIterator != _coalesceWindows.end())
+				{
+					//Raised with the latest value when the window closes.
+					windowIterator->second.pending = true;
+					_coalescedEvents++;
+					keep = false;
+				}
+				else _coalesceWindows[key].timerId = startCoalesceWindow(channel, valueKeys->at(i), window);
+			}
+
+			if(!keep)
+			{
+				if(!keptKeys)
+				{
+					keptKeys = _valueKeyPool.get();
+					keptValues = _valuePool.get();
+					keptKeys->insert(keptKeys->end(), valueKeys->begin(), valueKeys->begin() + i);
+					keptValues->insert(keptValues->end(), values->begin(), values->begin() + i);
+				}
+			}
+			else if(keptKeys)
+			{
+				keptKeys->push_back(valueKeys->at(i));
+				keptValues->push_back(values->at(i));
+			}
+		}
+		if(keptKeys)
+		{
+			valueKeys = keptKeys;
+			values = keptValues;
+		}
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
+uint64_t KodiPeer::startCoalesceWindow(uint32_t channel, const std::string& name, int64_t window)
+{
+	//The peer is looked up again when the window closes, because it might have been deleted in the meantime.
+	uint64_t peerId = _peerID;
+	return GD::eventLoop->addTimer(window, [peerId, channel, name]()
+	{
+		std::shared_ptr<KodiCentral> central = std::dynamic_pointer_cast<KodiCentral>(GD::family->getCentral());
+		if(!central) return;
+		std::shared_ptr<KodiPeer> peer = central->getPeer(peerId);
+		if(peer) peer->coalesceWindowEnded(channel, name);
+	});
+}
+
+void KodiPeer::coalesceWindowEnded(uint32_t channel, const std::string& name)
+{
+	try
+	{
+		std::shared_ptr<const ChangeFilter> changeFilter;
+		{
+			std::lock_guard<std::mutex> changeFilterGuard(_changeFilterMutex);
+			changeFilter = _changeFilter;
+		}
+
+		{
+			std::lock_guard<std::mutex> coalesceWindowsGuard(_coalesceWindowsMutex);
+			std::map<std::pair<uint32_t, std::string>, CoalesceWindow>::iterator windowIterator = _coalesceWindows.find(std::make_pair(channel, name));
+			if(windowIterator == _coalesceWindows.end()) return;
+			if(!windowIterator->second.pending || _disposing)
+			{
+				_coalesceWindows.erase(windowIterator);
+				return;
+			}
+
+			//Keep merging while events keep coming in.
+			int64_t window = changeFilter ? changeFilter->getCoalesceWindow(name) : 0;
+			if(window > 0)
+			{
+				windowIterator->second.pending = false;
+				windowIterator->second.timerId = startCoalesceWindow(channel, name, window);
+			}
+			else _coalesceWindows.erase(windowIterator);
+		}
+
+		raiseCoalescedEvent(channel, name);
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
+void KodiPeer::raiseCoalescedEvent(uint32_t channel, const std::string& name)
+{
+	try
+	{
+		//Trailing event with the latest value
+		std::unordered_map<uint32_t, std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>>::iterator channelIterator = valuesCentral.find(channel);
+		if(channelIterator == valuesCentral.end()) return;
+		std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator parameterIterator = channelIterator->second.find(name);
+		if(parameterIterator == channelIterator->second.end() || !parameterIterator->second.rpcParameter) return;
+		std::vector<uint8_t> parameterData = parameterIterator->second.getBinaryData();
+		std::shared_ptr<std::vector<std::string>> valueKeys = _valueKeyPool.get();
+		std::shared_ptr<std::vector<PVariable>> values = _valuePool.get();
+		valueKeys->push_back(name);
+		values->push_back(parameterIterator->second.rpcParameter->convertFromPacket(parameterData, parameterIterator->second.mainRole(), true));
+
+		raiseEvent(_eventSource, _peerID, channel, valueKeys, values);
+		raiseRPCEvent(_eventSource, _peerID, channel, getChannelAddress(channel), valueKeys, values);
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
+void KodiPeer::closeCoalesceWindows()
+{
+	try
+	{
+		std::vector<std::pair<uint32_t, std::string>> pendingEvents;
+		{
+			std::lock_guard<std::mutex> coalesceWindowsGuard(_coalesceWindowsMutex);
+			for(auto& window : _coalesceWindows)
+			{
+				if(GD::eventLoop) GD::eventLoop->removeTimer(window.second.timerId);
+				if(window.second.pending) pendingEvents.push_back(window.first);
+			}
+			_coalesceWindows.clear();
+		}
+		if(_disposing) return;
+		for(auto& event : pendingEvents)
+		{
+			raiseCoalescedEvent(event.first, event.second);
+		}
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
+void KodiPeer::stopCoalescing()
+{
+	try
+	{
+		std::lock_guard<std::mutex> coalesceWindowsGuard(_coalesceWindowsMutex);
+		for(auto& window : _coalesceWindows)
+		{
+			if(GD::eventLoop) GD::eventLoop->removeTimer(window.second.timerId);
+		}
+		_coalesceWindows.clear();
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
+KodiInterface::Subscriber KodiPeer::createSubscriber()
+{
+	KodiInterface::Subscriber subscriber;
+	try
+	{
+		subscriber.id = _peerID;
+		subscriber.connected = std::bind(&KodiPeer::connected, this, std::placeholders::_1);
+		subscriber.packetReceived = std::bind(&KodiPeer::packetReceived, this, std::placeholders::_1);
+		subscriber.reconnectScheduled = std::bind(&KodiPeer::reconnectScheduled, this, std::placeholders::_1, std::placeholders::_2);
+		subscriber.roundTripMeasured = std::bind(&KodiPeer::roundTripMeasured, this, std::placeholders::_1);
+		if(!_rpcDevice) return subscriber;
+		for(PacketsByFunction::iterator i = _rpcDevice->packetsByFunction1.begin(); i != _rpcDevice->packetsByFunction1.end(); ++i)
+		{
+			if(!i->second || i->second->direction != Packet::Direction::Enum::toCentral) continue;
+			subscriber.methods.push_back(i->first);
+			std::string::size_type dotPosition = i->first.find('.');
+			if(dotPosition == std::string::npos || dotPosition == 0) continue;
+			subscriber.namespaces.insert(i->first.substr(0, dotPosition));
+		}
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    return subscriber;
+}
+
+std::shared_ptr<KodiInterface> KodiPeer::getInterface()
+{
+	std::lock_guard<std::mutex> interfaceGuard(_interfaceMutex);
+	return _interface;
+}
+
+void KodiPeer::connectInterface(const std::string& hostname, int32_t port)
+{
+	try
+	{
+		if(!GD::connections) return;
+		std::shared_ptr<KodiInterface> interface;
+		std::shared_ptr<KodiInterface> oldInterface;
+		{
+			std::lock_guard<std::mutex> interfaceGuard(_interfaceMutex);
+			if(_interface && (_interface->getHostname() != hostname || _interface->getPort() != port)) oldInterface = std::move(_interface);
+			interface = _interface;
+		}
+		//The lock is not held while releasing, because that waits for running callbacks of this peer.
+		if(oldInterface) GD::connections->release(oldInterface, _peerID);
+		if(!interface)
+		{
+			if(hostname.empty()) return;
+			interface = GD::connections->acquire(hostname, port, createSubscriber());
+			if(!interface) return;
+			std::lock_guard<std::mutex> interfaceGuard(_interfaceMutex);
+			_interface = interface;
+		}
+		//The connection might be shared with other peers. The settings of the peer configured last are used.
+		interface->setReconnectDelays(getConfigInteger(0, "RECONNECT_MIN_DELAY", 1000), getConfigInteger(0, "RECONNECT_MAX_DELAY", 60000));
+		interface->setHeartbeat(getConfigInteger(0, "HEARTBEAT_INTERVAL", 30000), getConfigInteger(0, "HEARTBEAT_MISSES", 3));
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
+void KodiPeer::disconnectInterface()
+{
+	try
+	{
+		std::shared_ptr<KodiInterface> interface;
+		{
+			std::lock_guard<std::mutex> interfaceGuard(_interfaceMutex);
+			interface = std::move(_interface);
+		}
+		if(interface && GD::connections) GD::connections->release(interface, _peerID);
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
 void KodiPeer::saveVariables()
 {
 	try
@@ -331,34 +959,156 @@ void KodiPeer::saveVariables()
     }
 }
 
-void KodiPeer::connected(bool connected)
+void KodiPeer::updateMetrics()
+{
+	try
+	{
+		std::shared_ptr<KodiInterface> interface = getInterface();
+		if(!interface) return;
+		BaseLib::PVariable metrics = interface->getMetrics();
+		auto getCounter = [&](const std::string& name) -> int64_t
+		{
+			auto metricIterator = metrics->structValue->find(name);
+			return metricIterator == metrics->structValue->end() ? 0 : metricIterator->second->integerValue64;
+		};
+		auto getHistogram = [&](const std::string& name) -> PVariable
+		{
+			auto metricIterator = metrics->structValue->find(name);
+			return metricIterator == metrics->structValue->end() ? std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct) : metricIterator->second;
+		};
+
+		std::vector<std::pair<std::string, PVariable>> values
+		{
+			{"BYTES_RECEIVED", std::make_shared<BaseLib::Variable>(getCounter("bytesReceived"))},
+			{"BYTES_SENT", std::make_shared<BaseLib::Variable>(getCounter("bytesSent"))},
+			{"FRAMES_RECEIVED", std::make_shared<BaseLib::Variable>(getCounter("framesReceived"))},
+			{"FRAMES_SENT", std::make_shared<BaseLib::Variable>(getCounter("framesSent"))},
+			{"DECODE_TIMES", getHistogram("decodeTimes")},
+			{"REQUEST_TIMES", getHistogram("requestTimes")},
+			{"TIMEOUTS", std::make_shared<BaseLib::Variable>(getCounter("timeouts"))},
+			{"RECONNECTS", std::make_shared<BaseLib::Variable>(getCounter("reconnects"))},
+			{"PENDING_REQUESTS", std::make_shared<BaseLib::Variable>(getCounter("queuedRequests") + getCounter("inFlightRequests"))},
+			{"DROPPED_FRAMES", std::make_shared<BaseLib::Variable>(getCounter("skippedFrames") + getCounter("unmatchedResponses") + getCounter("droppedNotifications") + getCounter("overflowedNotifications"))},
+			{"SUPPRESSED_VALUES", std::make_shared<BaseLib::Variable>((int64_t)_suppressedValues.load())},
+			{"COALESCED_EVENTS", std::make_shared<BaseLib::Variable>((int64_t)_coalescedEvents.load())}
+		};
+
+		std::unordered_map<uint32_t, std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>>::iterator channelIterator = valuesCentral.find(15);
+		if(channelIterator == valuesCentral.end()) return;
+		for(auto& value : values)
+		{
+			std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator parameterIterator = channelIterator->second.find(value.first);
+			if(parameterIterator == channelIterator->second.end() || !parameterIterator->second.rpcParameter) continue;
+			std::vector<uint8_t> parameterData;
+			_binaryEncoder->encodeResponse(value.second, parameterData);
+			//Metrics change constantly, so they are neither saved nor raise events.
+			parameterIterator->second.setBinaryData(parameterData);
+		}
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
+BaseLib::PVariable KodiPeer::getConfigValue(uint32_t channel, const std::string& name)
 {
 	try
 	{
-		int32_t channel = 11;
+		std::unordered_map<uint32_t, std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>>::iterator channelIterator = configCentral.find(channel);
+		if(channelIterator == configCentral.end()) return BaseLib::PVariable();
+		std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator parameterIterator = channelIterator->second.find(name);
+		if(parameterIterator == channelIterator->second.end() || !parameterIterator->second.rpcParameter) return BaseLib::PVariable();
+		std::vector<uint8_t> parameterData = parameterIterator->second.getBinaryData();
+		return parameterIterator->second.rpcParameter->convertFromPacket(parameterData, parameterIterator->second.mainRole(), false);
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    return BaseLib::PVariable();
+}
+
+int64_t KodiPeer::getConfigInteger(uint32_t channel, const std::string& name, int64_t defaultValue)
+{
+	BaseLib::PVariable value = getConfigValue(channel, name);
+	if(!value) return defaultValue;
+	return value->integerValue;
+}
+
+void KodiPeer::saveVariable(uint32_t channel, const std::string& name, const std::vector<uint8_t>& data)
+{
+	try
+	{
+		if(_disposing) return;
 		std::unordered_map<uint32_t, std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>>::iterator channelIterator = valuesCentral.find(channel);
 		if(channelIterator == valuesCentral.end()) return;
-		std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator parameterIterator = channelIterator->second.find("CONNECTED");
+		std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator parameterIterator = channelIterator->second.find(name);
 		if(parameterIterator == channelIterator->second.end()) return;
-		BaseLib::Systems::RpcConfigurationParameter& stateParameter = parameterIterator->second;
-		if(!stateParameter.rpcParameter) return;
-		BaseLib::PVariable value(new BaseLib::Variable(connected));
+		uint64_t databaseId = parameterIterator->second.databaseId;
+
+		//Parameters without a row are inserted right away, because inserting updates the parameter. So the flushing thread only needs the
+		//database id and never accesses the peer's maps.
+		if(databaseId == 0 || !GD::persistence)
+		{
+			std::vector<uint8_t> writeData(data);
+			if(databaseId > 0) saveParameter(databaseId, writeData);
+			else saveParameter(0, ParameterGroup::Type::Enum::variables, channel, name, writeData);
+			return;
+		}
+
+		//The peer is looked up when the value is written, because it might have been deleted in the meantime.
+		uint64_t peerId = _peerID;
+		GD::persistence->save(_peerID, channel, name, data, [peerId, databaseId](std::vector<uint8_t>& data)
+		{
+			std::shared_ptr<KodiCentral> central = std::dynamic_pointer_cast<KodiCentral>(GD::family->getCentral());
+			if(!central) return;
+			std::shared_ptr<KodiPeer> peer = central->getPeer(peerId);
+			if(peer) peer->saveParameter(databaseId, data);
+		});
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
 
-		std::vector<uint8_t> newValue;
-		_binaryEncoder->encodeResponse(value, newValue);
-		if(stateParameter.equals(newValue)) return;
-		stateParameter.setBinaryData(newValue);
-		if(stateParameter.databaseId > 0) saveParameter(stateParameter.databaseId, newValue);
-		else saveParameter(0, ParameterGroup::Type::Enum::variables, channel, "CONNECTED", newValue);
-		if(_bl->debugLevel >= 4) GD::out.printInfo("Info: CONNECTED of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":1 was set to 0x" + BaseLib::HelperFunctions::getHexString(newValue) + ".");
+void KodiPeer::setSystemVariables(std::shared_ptr<std::vector<std::string>> valueKeys, std::shared_ptr<std::vector<PVariable>> values)
+{
+	try
+	{
+		if(_disposing || valueKeys->size() != values->size()) return;
+		int32_t channel = 14;
+		std::unordered_map<uint32_t, std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>>::iterator channelIterator = valuesCentral.find(channel);
+		if(channelIterator == valuesCentral.end()) return;
 
-		std::shared_ptr<std::vector<std::string>> valueKeys(new std::vector<std::string>{"CONNECTED"});
-		std::shared_ptr<std::vector<PVariable>> rpcValues(new std::vector<PVariable>{value});
+		std::shared_ptr<std::vector<std::string>> changedKeys;
+		std::shared_ptr<std::vector<PVariable>> changedValues;
+		for(uint32_t i = 0; i < valueKeys->size(); i++)
+		{
+			std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator parameterIterator = channelIterator->second.find(valueKeys->at(i));
+			if(parameterIterator == channelIterator->second.end()) continue;
+			BaseLib::Systems::RpcConfigurationParameter& parameter = parameterIterator->second;
+			if(!parameter.rpcParameter) continue;
 
-        std::string eventSource = "device-" + std::to_string(_peerID);
-		std::string address(_serialNumber + ":" + std::to_string(channel));
-		raiseEvent(eventSource, _peerID, channel, valueKeys, rpcValues);
-		raiseRPCEvent(eventSource, _peerID, channel, address, valueKeys, rpcValues);
+			std::vector<uint8_t> newValue;
+			_binaryEncoder->encodeResponse(values->at(i), newValue);
+			if(parameter.equals(newValue)) continue;
+			parameter.setBinaryData(newValue);
+			saveVariable(channel, valueKeys->at(i), newValue);
+			if(_bl->debugLevel >= 4) GD::out.printInfo("Info: " + valueKeys->at(i) + " of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":" + std::to_string(channel) + " was set to 0x" + BaseLib::HelperFunctions::getHexString(newValue) + ".");
+			if(!changedKeys)
+			{
+				changedKeys = _valueKeyPool.get();
+				changedValues = _valuePool.get();
+			}
+			changedKeys->push_back(valueKeys->at(i));
+			changedValues->push_back(values->at(i));
+		}
+		if(!changedKeys) return;
+
+		raiseEvent(_eventSource, _peerID, channel, changedKeys, changedValues);
+		raiseRPCEvent(_eventSource, _peerID, channel, getChannelAddress(channel), changedKeys, changedValues);
 	}
 	catch(const std::exception& ex)
     {
@@ -366,107 +1116,104 @@ void KodiPeer::connected(bool connected)
     }
 }
 
-void KodiPeer::getValuesFromPacket(std::shared_ptr<KodiPacket> packet, std::vector<FrameValues>& frameValues)
+void KodiPeer::connected(bool connected)
 {
 	try
 	{
-		if(!_rpcDevice) return;
-		//equal_range returns all elements with "0" or an unknown element as argument
-		if(_rpcDevice->packetsByFunction1.find(packet->getMethod()) == _rpcDevice->packetsByFunction1.end()) return;
-		std::pair<PacketsByFunction::iterator, PacketsByFunction::iterator> range = _rpcDevice->packetsByFunction1.equal_range(packet->getMethod());
-		if(range.first == _rpcDevice->packetsByFunction1.end()) return;
-		PacketsByFunction::iterator i = range.first;
-		do
+		std::shared_ptr<std::vector<std::string>> valueKeys = _valueKeyPool.get();
+		std::shared_ptr<std::vector<PVariable>> values = _valuePool.get();
+		valueKeys->push_back("CONNECTED");
+		values->push_back(std::make_shared<BaseLib::Variable>(connected));
+		setSystemVariables(valueKeys, values);
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
+void KodiPeer::reconnectScheduled(uint32_t attempts, int64_t delay)
+{
+	try
+	{
+		std::shared_ptr<std::vector<std::string>> valueKeys = _valueKeyPool.get();
+		std::shared_ptr<std::vector<PVariable>> values = _valuePool.get();
+		valueKeys->push_back("RECONNECT_ATTEMPTS");
+		valueKeys->push_back("TIME_TO_RECONNECT");
+		values->push_back(std::make_shared<BaseLib::Variable>((int32_t)attempts));
+		values->push_back(std::make_shared<BaseLib::Variable>((int32_t)delay));
+		setSystemVariables(valueKeys, values);
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
+void KodiPeer::roundTripMeasured(int64_t roundTripTime)
+{
+	try
+	{
+		std::shared_ptr<KodiInterface> interface = getInterface();
+		if(!interface) return;
+		std::shared_ptr<std::vector<std::string>> valueKeys = _valueKeyPool.get();
+		std::shared_ptr<std::vector<PVariable>> values = _valuePool.get();
+		valueKeys->push_back("ROUND_TRIP_TIME");
+		valueKeys->push_back("ROUND_TRIP_TIMES");
+		values->push_back(std::make_shared<BaseLib::Variable>((int32_t)roundTripTime));
+		values->push_back(interface->getRoundTripTimes().toVariable());
+		setSystemVariables(valueKeys, values);
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+}
+
+void KodiPeer::getValuesFromPacket(KodiPacket& packet, std::vector<FrameValues>& frameValues)
+{
+	try
+	{
+		std::unordered_map<std::string, std::vector<NotificationFrame>>::const_iterator tableIterator = _notificationTable.find(packet.getMethod());
+		if(tableIterator == _notificationTable.end()) return;
+		for(const NotificationFrame& frame : tableIterator->second)
 		{
 			FrameValues currentFrameValues;
-			PPacket frame(i->second);
-			if(!frame) continue;
-			if(frame->direction != Packet::Direction::Enum::toCentral) continue;
-			int32_t channel = -1;
-			if(frame->channel > -1) channel = frame->channel;
-			currentFrameValues.frameID = frame->id;
+			currentFrameValues.frameID = frame.frameId;
 
-			for(JsonPayloads::iterator j = frame->jsonPayloads.begin(); j != frame->jsonPayloads.end(); ++j)
+			for(const NotificationBinding& binding : frame.bindings)
 			{
-				BaseLib::PVariable value;
-				if((*j)->constValueBooleanSet) value.reset(new BaseLib::Variable((*j)->constValueBoolean));
-				else if((*j)->constValueIntegerSet) value.reset(new BaseLib::Variable((*j)->constValueInteger));
-				else if((*j)->constValueDecimalSet) value.reset(new BaseLib::Variable((*j)->constValueDecimal));
-				else if((*j)->constValueStringSet) value.reset(new BaseLib::Variable((*j)->constValueString));
-				else
-				{
-					value = packet->getJson();
-					if(!value) continue;
-					bool notFound = false;
-					for(std::vector<std::string>::iterator k = (*j)->keyPath.begin(); k != (*j)->keyPath.end(); ++k)
-					{
-						BaseLib::Struct::iterator jsonValueIterator = value->structValue->find(*k);
-						if(jsonValueIterator == value->structValue->end() || !jsonValueIterator->second)
-						{
-							notFound = true;
-							break;
-						}
-						value = jsonValueIterator->second;
-					}
-					if(notFound) continue;
-				}
-
+				//Only values bound to a parameter are converted.
+				BaseLib::PVariable value = binding.constValue ? binding.constValue : packet.getValue(binding.keyPath);
 				if(!value) continue;
 
-				for(std::vector<PParameter>::iterator k = frame->associatedVariables.begin(); k != frame->associatedVariables.end(); ++k)
+				for(const NotificationTarget& target : binding.targets)
 				{
-					if((*k)->physical->groupId != (*j)->parameterId) continue;
-					currentFrameValues.parameterSetType = (*k)->parent()->type();
-					bool setValues = false;
-					if(currentFrameValues.paramsetChannels.empty()) //Fill paramsetChannels
+					currentFrameValues.parameterSetType = target.parameterSetType;
+					const std::string& parameterId = target.parameter->id;
+					//The first parameter found determines the channels of the frame.
+					if(currentFrameValues.paramsetChannels.empty())
 					{
-						int32_t startChannel = (channel < 0) ? 0 : channel;
-						int32_t endChannel;
-						//When fixedChannel is -2 (means '*') cycle through all channels
-						if(frame->channel == -2)
-						{
-							startChannel = 0;
-							endChannel = _rpcDevice->functions.rbegin()->first;
-						}
-						else endChannel = startChannel;
-						for(int32_t l = startChannel; l <= endChannel; l++)
-						{
-							Functions::iterator functionIterator = _rpcDevice->functions.find(l);
-							if(functionIterator == _rpcDevice->functions.end()) continue;
-							PParameterGroup parameterGroup = functionIterator->second->getParameterGroup(currentFrameValues.parameterSetType);
-							Parameters::iterator parameterIterator = parameterGroup->parameters.find((*k)->id);
-							if(parameterIterator == parameterGroup->parameters.end()) continue;
-							currentFrameValues.paramsetChannels.push_back(l);
-							currentFrameValues.values[(*k)->id].channels.push_back(l);
-							setValues = true;
-						}
+						currentFrameValues.paramsetChannels.insert(currentFrameValues.paramsetChannels.end(), target.channels.begin(), target.channels.end());
+						currentFrameValues.values[parameterId].channels.insert(currentFrameValues.values[parameterId].channels.end(), target.channels.begin(), target.channels.end());
 					}
-					else //Use paramsetChannels
+					else
 					{
+						bool setValues = false;
 						for(std::list<uint32_t>::const_iterator l = currentFrameValues.paramsetChannels.begin(); l != currentFrameValues.paramsetChannels.end(); ++l)
 						{
-							Functions::iterator functionIterator = _rpcDevice->functions.find(*l);
-							if(functionIterator == _rpcDevice->functions.end()) continue;
-							PParameterGroup parameterGroup = functionIterator->second->getParameterGroup(currentFrameValues.parameterSetType);
-							Parameters::iterator parameterIterator = parameterGroup->parameters.find((*k)->id);
-							if(parameterIterator == parameterGroup->parameters.end()) continue;
-							currentFrameValues.values[(*k)->id].channels.push_back(*l);
+							if(std::find(target.channels.begin(), target.channels.end(), *l) == target.channels.end()) continue;
+							currentFrameValues.values[parameterId].channels.push_back(*l);
 							setValues = true;
 						}
+						if(!setValues) continue;
 					}
 
-					if(setValues)
-					{
-						//This is a little nasty and costs a lot of resources, but we need to run the data through the packet converter
-						std::vector<uint8_t> encodedData;
-						_binaryEncoder->encodeResponse(value, encodedData);
-						PVariable data = (*k)->convertFromPacket(encodedData, Role(), true);
-						(*k)->convertToPacket(data, Role(), currentFrameValues.values[(*k)->id].value);
-					}
+					target.converter.convert(value, *_binaryEncoder, currentFrameValues.values[parameterId].value);
 				}
 			}
-			if(!currentFrameValues.values.empty()) frameValues.push_back(currentFrameValues);
-		} while(++i != range.second && i != _rpcDevice->packetsByFunction1.end());
+			if(!currentFrameValues.values.empty()) frameValues.push_back(std::move(currentFrameValues));
+		}
 	}
 	catch(const std::exception& ex)
     {
@@ -474,15 +1221,25 @@ void KodiPeer::getValuesFromPacket(std::shared_ptr<KodiPacket> packet, std::vect
     }
 }
 
-void KodiPeer::packetReceived(std::shared_ptr<KodiPacket> packet)
+void KodiPeer::packetReceived(KodiPacket& packet)
 {
 	try
 	{
-		if(!packet) return;
 		if(_disposing || !_rpcDevice) return;
 		setLastPacketReceived();
-		std::map<uint32_t, std::shared_ptr<std::vector<std::string>>> valueKeys;
-		std::map<uint32_t, std::shared_ptr<std::vector<PVariable>>> rpcValues;
+		std::shared_ptr<const ChangeFilter> changeFilter;
+		{
+			std::lock_guard<std::mutex> changeFilterGuard(_changeFilterMutex);
+			changeFilter = _changeFilter;
+		}
+		//Notifications usually set the values of one channel only, so the events are kept in a flat list.
+		struct ChannelEvent
+		{
+			uint32_t channel = 0;
+			std::shared_ptr<std::vector<std::string>> valueKeys;
+			std::shared_ptr<std::vector<PVariable>> values;
+		};
+		std::vector<ChannelEvent> events;
 
 		std::vector<FrameValues> frameValues;
 		getValuesFromPacket(packet, frameValues);
@@ -490,9 +1247,6 @@ void KodiPeer::packetReceived(std::shared_ptr<KodiPacket> packet)
 		//Loop through all matching frames
 		for(std::vector<FrameValues>::iterator a = frameValues.begin(); a != frameValues.end(); ++a)
 		{
-			PPacket frame;
-			if(!a->frameID.empty()) frame = _rpcDevice->packetsById.at(a->frameID);
-
 			for(std::map<std::string, FrameValue>::iterator i = a->values.begin(); i != a->values.end(); ++i)
 			{
 				for(std::list<uint32_t>::const_iterator j = a->paramsetChannels.begin(); j != a->paramsetChannels.end(); ++j)
@@ -501,15 +1255,14 @@ void KodiPeer::packetReceived(std::shared_ptr<KodiPacket> packet)
 
 					BaseLib::Systems::RpcConfigurationParameter& parameter = valuesCentral[*j][i->first];
 
-					if(!valueKeys[*j] || !rpcValues[*j])
+					if(changeFilter && isUnchanged(*changeFilter, parameter, i->first, i->second.value))
 					{
-						valueKeys[*j].reset(new std::vector<std::string>());
-						rpcValues[*j].reset(new std::vector<PVariable>());
+						_suppressedValues++;
+						continue;
 					}
 
 					parameter.setBinaryData(i->second.value);
-					if(parameter.databaseId > 0) saveParameter(parameter.databaseId, i->second.value);
-					else saveParameter(0, ParameterGroup::Type::Enum::variables, *j, i->first, i->second.value);
+					saveVariable(*j, i->first, i->second.value);
 					if(_bl->debugLevel >= 4) GD::out.printInfo("Info: " + i->first + " of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":" + std::to_string(*j) + " was set to 0x" + BaseLib::HelperFunctions::getHexString(i->second.value) + ".");
 
 					if(parameter.rpcParameter)
@@ -527,23 +1280,25 @@ void KodiPeer::packetReceived(std::shared_ptr<KodiPacket> packet)
 							}
 						}
 
-						valueKeys[*j]->push_back(i->first);
-						rpcValues[*j]->push_back(parameter.rpcParameter->convertFromPacket(i->second.value, parameter.mainRole(), true));
+						std::vector<ChannelEvent>::iterator event = std::find_if(events.begin(), events.end(), [&](const ChannelEvent& event) { return event.channel == *j; });
+						if(event == events.end())
+						{
+							events.push_back(ChannelEvent{*j, _valueKeyPool.get(), _valuePool.get()});
+							event = events.end() - 1;
+						}
+						event->valueKeys->push_back(i->first);
+						event->values->push_back(parameter.rpcParameter->convertFromPacket(i->second.value, parameter.mainRole(), true));
 					}
 				}
 			}
 		}
 
-		if(!rpcValues.empty())
+		for(ChannelEvent& event : events)
 		{
-			for(std::map<uint32_t, std::shared_ptr<std::vector<std::string>>>::iterator j = valueKeys.begin(); j != valueKeys.end(); ++j)
-			{
-				if(j->second->empty()) continue;
-                std::string eventSource = "device-" + std::to_string(_peerID);
-                std::string address(_serialNumber + ":" + std::to_string(j->first));
-                raiseEvent(eventSource, _peerID, j->first, j->second, rpcValues.at(j->first));
-                raiseRPCEvent(eventSource, _peerID, j->first, address, j->second, rpcValues.at(j->first));
-			}
+			if(changeFilter) coalesceEvents(*changeFilter, event.channel, event.valueKeys, event.values);
+			if(event.valueKeys->empty()) continue;
+			raiseEvent(_eventSource, _peerID, event.channel, event.valueKeys, event.values);
+			raiseRPCEvent(_eventSource, _peerID, event.channel, getChannelAddress(event.channel), event.valueKeys, event.values);
 		}
 	}
 	catch(const std::exception& ex)
@@ -568,6 +1323,34 @@ PParameterGroup KodiPeer::getParameterSet(int32_t channel, ParameterGroup::Type:
 	return PParameterGroup();
 }
 
+PVariable KodiPeer::getParamset(BaseLib::PRpcClientInfo clientInfo, int32_t channel, ParameterGroup::Type::Enum type, uint64_t remoteID, int32_t remoteChannel, bool checkAcls)
+{
+	try
+	{
+		if(channel == 15 && type == ParameterGroup::Type::Enum::variables) updateMetrics();
+		return Peer::getParamset(clientInfo, channel, type, remoteID, remoteChannel, checkAcls);
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    return Variable::createError(-32500, "Unknown application error.");
+}
+
+PVariable KodiPeer::getValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channel, std::string valueKey, bool requestFromDevice, bool asynchronous)
+{
+	try
+	{
+		if(channel == 15) updateMetrics();
+		return Peer::getValue(clientInfo, channel, valueKey, requestFromDevice, asynchronous);
+	}
+	catch(const std::exception& ex)
+    {
+    	GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+    }
+    return Variable::createError(-32500, "Unknown application error.");
+}
+
 PVariable KodiPeer::putParamset(BaseLib::PRpcClientInfo clientInfo, int32_t channel, ParameterGroup::Type::Enum type, uint64_t remoteID, int32_t remoteChannel, PVariable variables, bool checkAcls, bool onlyPushing)
 {
 	try
@@ -588,8 +1371,10 @@ PVariable KodiPeer::putParamset(BaseLib::PRpcClientInfo clientInfo, int32_t chan
 		if(type == ParameterGroup::Type::Enum::config)
 		{
 			bool configChanged = false;
-			std::string newHostname;
-			int32_t newPort = -1;
+			bool reconnectDelaysChanged = false;
+			bool heartbeatChanged = false;
+			bool connectionChanged = false;
+			bool changeFilterChanged = false;
 			for(Struct::iterator i = variables->structValue->begin(); i != variables->structValue->end(); ++i)
 			{
 				if(i->first.empty() || !i->second) continue;
@@ -600,8 +1385,10 @@ PVariable KodiPeer::putParamset(BaseLib::PRpcClientInfo clientInfo, int32_t chan
 				BaseLib::Systems::RpcConfigurationParameter& parameter = parameterIterator->second;
 				if(!parameter.rpcParameter) continue;
 
-				if(i->first == "HOSTNAME" && i->second->stringValue != _interface.getHostname()) newHostname = i->second->stringValue;
-				else if(i->first == "PORT" && i->second->integerValue != _interface.getPort()) newPort = i->second->integerValue;
+				if(i->first == "HOSTNAME" || i->first == "PORT") connectionChanged = true;
+				else if(i->first == "RECONNECT_MIN_DELAY" || i->first == "RECONNECT_MAX_DELAY") reconnectDelaysChanged = true;
+				else if(i->first == "HEARTBEAT_INTERVAL" || i->first == "HEARTBEAT_MISSES") heartbeatChanged = true;
+				else if(i->first == "SUPPRESS_UNCHANGED" || i->first.compare(0, 8, "COALESCE") == 0 || (i->first.size() > 9 && i->first.compare(i->first.size() - 9, 9, "_DEADBAND") == 0) || (i->first.size() > 16 && i->first.compare(i->first.size() - 16, 16, "_COALESCE_WINDOW") == 0)) changeFilterChanged = true;
 
 				std::vector<uint8_t> parameterData;
 				parameter.rpcParameter->convertToPacket(i->second, parameter.mainRole(), parameterData);
@@ -614,12 +1401,20 @@ PVariable KodiPeer::putParamset(BaseLib::PRpcClientInfo clientInfo, int32_t chan
 			}
 
 			if(configChanged) raiseRPCUpdateDevice(_peerID, channel, _serialNumber + ":" + std::to_string(channel), 0);
+			if(changeFilterChanged) loadChangeFilter();
 
-			if(!newHostname.empty() || newPort > 0)
+			if(connectionChanged)
+			{
+				//Switches to the connection of the new endpoint, which might be shared with other peers. Does nothing when the endpoint didn't change.
+				BaseLib::PVariable hostname = getConfigValue(0, "HOSTNAME");
+				BaseLib::PVariable port = getConfigValue(0, "PORT");
+				if(hostname && port) connectInterface(hostname->stringValue, port->integerValue);
+			}
+			else if(reconnectDelaysChanged || heartbeatChanged)
 			{
-				if(!newHostname.empty()) _interface.setHostname(newHostname);
-				if(newPort > 0) _interface.setPort(newPort);
-				_interface.startListening();
+				std::shared_ptr<KodiInterface> interface = getInterface();
+				if(interface && reconnectDelaysChanged) interface->setReconnectDelays(getConfigInteger(0, "RECONNECT_MIN_DELAY", 1000), getConfigInteger(0, "RECONNECT_MAX_DELAY", 60000));
+				if(interface && heartbeatChanged) interface->setHeartbeat(getConfigInteger(0, "HEARTBEAT_INTERVAL", 30000), getConfigInteger(0, "HEARTBEAT_MISSES", 3));
 			}
 		}
 		else if(type == ParameterGroup::Type::Enum::variables)
@@ -662,16 +1457,15 @@ PVariable KodiPeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channe
 		if(!rpcParameter) return Variable::createError(-5, "Unknown parameter.");
 		if(rpcParameter->logical->type == ILogical::Type::tAction && !value->booleanValue) return Variable::createError(-5, "Parameter of type action cannot be set to \"false\".");
 		BaseLib::Systems::RpcConfigurationParameter& parameter = parameterIterator->second;
-		std::shared_ptr<std::vector<std::string>> valueKeys(new std::vector<std::string>());
-		std::shared_ptr<std::vector<PVariable>> values(new std::vector<PVariable>());
+		std::shared_ptr<std::vector<std::string>> valueKeys = _valueKeyPool.get();
+		std::shared_ptr<std::vector<PVariable>> values = _valuePool.get();
 
 		if(rpcParameter->physical->operationType == IPhysical::OperationType::Enum::store)
 		{
 			std::vector<uint8_t> parameterData;
 			rpcParameter->convertToPacket(value, parameter.mainRole(), parameterData);
 			parameter.setBinaryData(parameterData);
-			if(parameter.databaseId > 0) saveParameter(parameter.databaseId, parameterData);
-			else saveParameter(0, ParameterGroup::Type::Enum::variables, channel, valueKey, parameterData);
+			saveVariable(channel, valueKey, parameterData);
 			value = rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false);
 			if(rpcParameter->readable)
 			{
@@ -680,9 +1474,8 @@ PVariable KodiPeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channe
 			}
 			if(!valueKeys->empty())
             {
-                std::string address(_serialNumber + ":" + std::to_string(channel));
                 raiseEvent(clientInfo->initInterfaceId, _peerID, channel, valueKeys, values);
-                raiseRPCEvent(clientInfo->initInterfaceId, _peerID, channel, address, valueKeys, values);
+                raiseRPCEvent(clientInfo->initInterfaceId, _peerID, channel, getChannelAddress(channel), valueKeys, values);
             }
 			return PVariable(new Variable(VariableType::tVoid));
 		}
@@ -695,8 +1488,7 @@ PVariable KodiPeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channe
 		std::vector<uint8_t> parameterData;
 		rpcParameter->convertToPacket(value, parameter.mainRole(), parameterData);
 		parameter.setBinaryData(parameterData);
-		if(parameter.databaseId > 0) saveParameter(parameter.databaseId, parameterData);
-		else saveParameter(0, ParameterGroup::Type::Enum::variables, channel, valueKey, parameterData);
+		saveVariable(channel, valueKey, parameterData);
 		if(_bl->debugLevel > 4) GD::out.printDebug("Debug: " + valueKey + " of peer " + std::to_string(_peerID) + " with serial number " + _serialNumber + ":" + std::to_string(channel) + " was set to " + BaseLib::HelperFunctions::getHexString(parameterData) + ".");
 
 		value = rpcParameter->convertFromPacket(parameterData, parameter.mainRole(), false);
@@ -706,56 +1498,43 @@ PVariable KodiPeer::setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channe
 			values->push_back(value);
 		}
 
-		PVariable parameters(new Variable(BaseLib::VariableType::tArray));
-		for(JsonPayloads::iterator i = frame->jsonPayloads.begin(); i != frame->jsonPayloads.end(); ++i)
+		std::unordered_map<std::string, KodiRequestTemplate>::iterator templateIterator = _requestTemplates.find(frame->id);
+		if(templateIterator == _requestTemplates.end()) return Variable::createError(-6, "No frame was found for parameter " + valueKey);
+		const KodiRequestTemplate& requestTemplate = templateIterator->second;
+		std::string request;
+		request.reserve(requestTemplate.size() + 32);
+		requestTemplate.append(request, [&](const std::string& parameterId, std::string& json)
 		{
-			if((*i)->constValueIntegerSet)
-			{
-				parameters->arrayValue->push_back(PVariable(new Variable((*i)->constValueInteger)));
-				continue;
-			}
-			if((*i)->constValueBooleanSet)
-			{
-				parameters->arrayValue->push_back(PVariable(new Variable((*i)->constValueBoolean)));
-				continue;
-			}
-            if((*i)->constValueStringSet)
-            {
-                parameters->arrayValue->push_back(std::make_shared<BaseLib::Variable>((*i)->constValueString));
-                continue;
-            }
 			//We can't just search for param, because it is ambiguous (see for example LEVEL for HM-CC-TC).
-			if((*i)->parameterId == rpcParameter->physical->groupId)
+			if(parameterId == rpcParameter->physical->groupId)
 			{
-				parameters->arrayValue->push_back(_binaryDecoder->decodeResponse(parameterData));
+				KodiRequestTemplate::appendValue(json, value);
+				return true;
 			}
 			//Search for all other parameters
-			else
+			for(std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator j = valuesCentral[channel].begin(); j != valuesCentral[channel].end(); ++j)
 			{
-				bool paramFound = false;
-				for(std::unordered_map<std::string, BaseLib::Systems::RpcConfigurationParameter>::iterator j = valuesCentral[channel].begin(); j != valuesCentral[channel].end(); ++j)
+				if(!j->second.rpcParameter) continue;
+				if(parameterId == j->second.rpcParameter->physical->groupId)
 				{
-					if(!j->second.rpcParameter) continue;
-					if((*i)->parameterId == j->second.rpcParameter->physical->groupId)
-					{
-						std::vector<uint8_t> additionalParameterData = j->second.getBinaryData();
-						parameters->arrayValue->push_back(_binaryDecoder->decodeResponse(additionalParameterData));
-						paramFound = true;
-						break;
-					}
+					std::vector<uint8_t> additionalParameterData = j->second.getBinaryData();
+					KodiRequestTemplate::appendValue(json, _binaryDecoder->decodeResponse(additionalParameterData));
+					return true;
 				}
-				if(!paramFound) GD::out.printError("Error constructing packet. param \"" + (*i)->parameterId + "\" not found. Peer: " + std::to_string(_peerID) + " Serial number: " + _serialNumber + " Frame: " + frame->id);
 			}
-		}
+			GD::out.printError("Error constructing packet. param \"" + parameterId + "\" not found. Peer: " + std::to_string(_peerID) + " Serial number: " + _serialNumber + " Frame: " + frame->id);
+			return false;
+		});
 
-		std::shared_ptr<KodiPacket> packet(new KodiPacket(frame->function1, parameters));
-		_interface.sendPacket(packet);
+		//With "wait" set to false the packet is only queued and this method returns without waiting for Kodi.
+		std::shared_ptr<KodiInterface> interface = getInterface();
+		if(!interface) return Variable::createError(-32500, "No hostname is set.");
+		if(!interface->sendCommand(std::move(request), wait)) return Variable::createError(-32500, "Outbound queue is full. Packet was dropped.");
 
 		if(!valueKeys->empty())
 		{
-            std::string address(_serialNumber + ":" + std::to_string(channel));
             raiseEvent(clientInfo->initInterfaceId, _peerID, channel, valueKeys, values);
-            raiseRPCEvent(clientInfo->initInterfaceId, _peerID, channel, address, valueKeys, values);
+            raiseRPCEvent(clientInfo->initInterfaceId, _peerID, channel, getChannelAddress(channel), valueKeys, values);
 		}
 
 		return PVariable(new Variable(VariableType::tVoid));
@@ -34,8 +34,13 @@
 
 #include <homegear-base/BaseLib.h>
 #include "KodiInterface.h"
+#include "KodiRequestTemplate.h"
+#include "KodiValueConverter.h"
+#include "KodiVectorPool.h"
 
 #include <list>
+#include <map>
+#include <unordered_set>
 
 using namespace BaseLib;
 using namespace BaseLib::DeviceDescription;
@@ -96,24 +101,238 @@ public:
     virtual void homegearShuttingDown();
 
 	//RPC methods
+	virtual PVariable getParamset(BaseLib::PRpcClientInfo clientInfo, int32_t channel, ParameterGroup::Type::Enum type, uint64_t remoteID, int32_t remoteChannel, bool checkAcls);
+	virtual PVariable getValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channel, std::string valueKey, bool requestFromDevice, bool asynchronous);
 	virtual PVariable putParamset(BaseLib::PRpcClientInfo clientInfo, int32_t channel, ParameterGroup::Type::Enum type, uint64_t remoteID, int32_t remoteChannel, PVariable variables, bool checkAcls, bool onlyPushing = false);
 	virtual PVariable setValue(BaseLib::PRpcClientInfo clientInfo, uint32_t channel, std::string valueKey, PVariable value, bool wait);
 	//End RPC methods
+
+	/**
+	 * Compiles the request templates and the notification table from the device description. Needs to be called after the
+	 * device description was set.
+	 */
+	void compileDeviceDescription();
+
+	/**
+	 * Builds the event source and the addresses of all channels used when raising events. Needs to be called when the peer id
+	 * or serial number changed.
+	 */
+	void initializeEventMetadata();
+
+	/**
+	 * Reads "SUPPRESS_UNCHANGED", the deadbands and the coalescing settings from the configuration. Needs to be called after the
+	 * configuration was loaded or initialized and when one of these parameters changed.
+	 */
+	void loadChangeFilter();
 protected:
 	std::shared_ptr<BaseLib::Rpc::RpcEncoder> _binaryEncoder;
 	std::shared_ptr<BaseLib::Rpc::RpcDecoder> _binaryDecoder;
 
 	bool _shuttingDown = false;
-	KodiInterface _interface;
+
+	/**
+	 * The connection to Kodi, shared with all peers using the same hostname and port. Not set while no hostname is configured.
+	 */
+	std::mutex _interfaceMutex;
+	std::shared_ptr<KodiInterface> _interface;
+
+	/**
+	 * Request templates of all packets sent to Kodi by packet id. Compiled in load().
+	 */
+	std::unordered_map<std::string, KodiRequestTemplate> _requestTemplates;
+
+	//{{{ Notification table
+	/**
+	 * A parameter set by a notification value together with all channels it exists in.
+	 */
+	struct NotificationTarget
+	{
+		PParameter parameter;
+		ParameterGroup::Type::Enum parameterSetType = ParameterGroup::Type::Enum::variables;
+		std::vector<uint32_t> channels;
+		KodiValueConverter converter;
+	};
+
+	/**
+	 * A value of a notification. Either a constant or the value at "keyPath" within the notification.
+	 */
+	struct NotificationBinding
+	{
+		std::vector<std::string> keyPath;
+		BaseLib::PVariable constValue;
+		std::vector<NotificationTarget> targets;
+	};
+
+	struct NotificationFrame
+	{
+		std::string frameId;
+		std::vector<NotificationBinding> bindings;
+	};
+
+	/**
+	 * The frames of all notifications by method, with all parameters and channels already resolved. Compiled in
+	 * compileNotificationTable() and not changed afterwards.
+	 */
+	std::unordered_map<std::string, std::vector<NotificationFrame>> _notificationTable;
+	//}}}
+
+	//{{{ Change filter
+	/**
+	 * Decides which values of notifications are stored and raise events. Loaded from the configuration of channel 0 and replaced
+	 * as a whole when it changes.
+	 */
+	struct ChangeFilter
+	{
+		/**
+		 * Ignore values equal to the stored value ("SUPPRESS_UNCHANGED").
+		 */
+		bool suppressUnchanged = false;
+
+		/**
+		 * Numeric changes smaller than the deadband are ignored. Set by the configuration parameters "<PARAMETER>_DEADBAND".
+		 */
+		std::unordered_map<std::string, double> deadbands;
+
+		/**
+		 * Events of a parameter are raised at most once per window in milliseconds ("COALESCE_WINDOW"). "0" disables merging.
+		 */
+		int64_t coalesceWindow = 0;
+
+		/**
+		 * Windows of single parameters set by the configuration parameters "<PARAMETER>_COALESCE_WINDOW".
+		 */
+		std::unordered_map<std::string, int64_t> coalesceWindows;
+
+		/**
+		 * Parameters whose events are never merged ("COALESCE_BYPASS").
+		 */
+		std::unordered_set<std::string> coalesceBypass;
+
+		int64_t getCoalesceWindow(const std::string& name) const;
+	};
+
+	std::mutex _changeFilterMutex;
+	std::shared_ptr<const ChangeFilter> _changeFilter;
+
+	/**
+	 * The number of values ignored by the change filter.
+	 */
+	std::atomic<uint64_t> _suppressedValues{0};
+	//}}}
+
+	//{{{ Event metadata
+	std::string _eventSource;
+	std::unordered_map<uint32_t, std::string> _channelAddresses;
+
+	/**
+	 * The vectors of raised events. Parameter names are short enough to be stored without allocation, so raising an event from a
+	 * reused vector usually doesn't allocate for the keys at all.
+	 */
+	KodiVectorPool<std::string> _valueKeyPool;
+	KodiVectorPool<PVariable> _valuePool;
+	//}}}
+
+	//{{{ Event coalescing
+	/**
+	 * An open coalescing window of a parameter. "pending" is set when an event was held back during the window.
+	 */
+	struct CoalesceWindow
+	{
+		uint64_t timerId = 0;
+		bool pending = false;
+	};
+
+	std::mutex _coalesceWindowsMutex;
+	std::map<std::pair<uint32_t, std::string>, CoalesceWindow> _coalesceWindows;
+
+	/**
+	 * The number of events merged into a later event.
+	 */
+	std::atomic<uint64_t> _coalescedEvents{0};
+	//}}}
 
 	virtual void loadVariables(BaseLib::Systems::ICentral* central, std::shared_ptr<BaseLib::Database::DataTable>& rows);
     virtual void saveVariables();
+    void compileRequestTemplates();
+    void compileNotificationTable();
+
+    /**
+     * @return Returns true when "value" should be ignored, because it doesn't differ enough from the stored value of "parameter".
+     */
+    bool isUnchanged(const ChangeFilter& changeFilter, BaseLib::Systems::RpcConfigurationParameter& parameter, const std::string& name, std::vector<uint8_t>& value);
+
+    /**
+     * Removes the events of parameters with an open coalescing window from "valueKeys" and "values". The first event of a parameter
+     * is raised immediately and opens the window. When the window closes, the latest value is raised if events were held back.
+     */
+    void coalesceEvents(const ChangeFilter& changeFilter, uint32_t channel, std::shared_ptr<std::vector<std::string>>& valueKeys, std::shared_ptr<std::vector<PVariable>>& values);
+
+    /**
+     * Opens a coalescing window. "_coalesceWindowsMutex" must be locked.
+     */
+    uint64_t startCoalesceWindow(uint32_t channel, const std::string& name, int64_t window);
+    void coalesceWindowEnded(uint32_t channel, const std::string& name);
+    void raiseCoalescedEvent(uint32_t channel, const std::string& name);
+
+    /**
+     * Closes all coalescing windows and raises the events held back. Called when the coalescing settings were reloaded.
+     */
+    void closeCoalesceWindows();
+    void stopCoalescing();
+
+    /**
+     * @return Returns the address "SERIAL:CHANNEL" used in events.
+     */
+    std::string& getChannelAddress(uint32_t channel);
 
+    /**
+     * Creates the subscriber passed to the connection. It contains the namespaces and methods of all notifications in the device
+     * description, so Kodi only sends those and the interface drops everything else before decoding.
+     */
+    KodiInterface::Subscriber createSubscriber();
+    std::shared_ptr<KodiInterface> getInterface();
+
+    /**
+     * Subscribes to the connection to "hostname" and "port" and releases the previous connection if the endpoint changed.
+     */
+    void connectInterface(const std::string& hostname, int32_t port);
+    void disconnectInterface();
+
+    /**
+     * Returns the value of a configuration parameter or nullptr if the parameter doesn't exist.
+     */
+    BaseLib::PVariable getConfigValue(uint32_t channel, const std::string& name);
+
+    /**
+     * Returns the value of an integer configuration parameter or "defaultValue" if the parameter doesn't exist.
+     */
+    int64_t getConfigInteger(uint32_t channel, const std::string& name, int64_t defaultValue);
+
+    /**
+     * Saves a variable through the module's write-behind cache (see KodiPersistence). Must be called on the thread changing the value.
+     */
+    void saveVariable(uint32_t channel, const std::string& name, const std::vector<uint8_t>& data);
+
+    /**
+     * Sets variables of the system channel without a packet from Kodi. Only changed values are saved and raise events.
+     */
+    void setSystemVariables(std::shared_ptr<std::vector<std::string>> valueKeys, std::shared_ptr<std::vector<PVariable>> values);
+
+    /**
+     * Copies the metrics of the connection to the read-only variables of channel 15 "Metrics". Called when they are polled.
+     */
+    void updateMetrics();
     void connected(bool connected);
-    void packetReceived(std::shared_ptr<KodiPacket> packet);
+    void reconnectScheduled(uint32_t attempts, int64_t delay);
+    void roundTripMeasured(int64_t roundTripTime);
+
+    /**
+     * Extracts the values of a notification, saves them and raises events.
+     */
+    void packetReceived(KodiPacket& packet);
 
 	virtual std::shared_ptr<BaseLib::Systems::ICentral> getCentral();
-	void getValuesFromPacket(std::shared_ptr<KodiPacket> packet, std::vector<FrameValues>& frameValue);
+	void getValuesFromPacket(KodiPacket& packet, std::vector<FrameValues>& frameValue);
 
 	virtual PParameterGroup getParameterSet(int32_t channel, ParameterGroup::Type::Enum type);
 };
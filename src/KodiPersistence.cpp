@@ -0,0 +1,210 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiPersistence.h"
+#include "GD.h"
+
+#include <chrono>
+
+namespace Kodi
+{
+
+KodiPersistence::~KodiPersistence()
+{
+	stop();
+}
+
+void KodiPersistence::start(int64_t interval)
+{
+	try
+	{
+		_interval = interval;
+		_stopped = false;
+		if(interval > 0) scheduleFlush();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void KodiPersistence::stop()
+{
+	try
+	{
+		_stopped = true;
+		uint64_t timerId = _timerId.exchange(0);
+		if(timerId != 0 && GD::eventLoop) GD::eventLoop->removeTimer(timerId);
+		flush();
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void KodiPersistence::scheduleFlush()
+{
+	if(_stopped || !GD::eventLoop) return;
+	_timerId = GD::eventLoop->addTimer(_interval, [this]()
+	{
+		_timerId = 0;
+		flush();
+		scheduleFlush();
+	});
+}
+
+void KodiPersistence::save(uint64_t peerId, uint32_t channel, const std::string& name, const std::vector<uint8_t>& data, WriteCallback writeCallback)
+{
+	try
+	{
+		_updates++;
+		if(_interval <= 0 || _stopped)
+		{
+			std::lock_guard<std::mutex> writeGuard(_writeMutex);
+			std::vector<uint8_t> writeData(data);
+			writeCallback(writeData);
+			_writes++;
+			return;
+		}
+
+		std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+		Entry& entry = _entries[Key(peerId, channel, name)];
+		entry.data = data;
+		entry.writeCallback = std::move(writeCallback);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void KodiPersistence::flush()
+{
+	try
+	{
+		std::lock_guard<std::mutex> writeGuard(_writeMutex);
+		std::map<Key, Entry> entries;
+		{
+			std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+			entries.swap(_entries);
+		}
+		write(entries);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void KodiPersistence::flush(uint64_t peerId)
+{
+	try
+	{
+		std::lock_guard<std::mutex> writeGuard(_writeMutex);
+		std::map<Key, Entry> entries;
+		{
+			std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+			auto begin = _entries.lower_bound(Key(peerId, 0, std::string()));
+			auto end = begin;
+			while(end != _entries.end() && std::get<0>(end->first) == peerId) ++end;
+			entries.insert(std::make_move_iterator(begin), std::make_move_iterator(end));
+			_entries.erase(begin, end);
+		}
+		write(entries);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void KodiPersistence::discard(uint64_t peerId)
+{
+	try
+	{
+		std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+		auto begin = _entries.lower_bound(Key(peerId, 0, std::string()));
+		auto end = begin;
+		while(end != _entries.end() && std::get<0>(end->first) == peerId) ++end;
+		_entries.erase(begin, end);
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+}
+
+void KodiPersistence::write(std::map<Key, Entry>& entries)
+{
+	if(entries.empty()) return;
+	auto startTime = std::chrono::steady_clock::now();
+	for(auto& entry : entries)
+	{
+		try
+		{
+			entry.second.writeCallback(entry.second.data);
+			_writes++;
+		}
+		catch(const std::exception& ex)
+		{
+			GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+		}
+	}
+	_flushes++;
+	_flushTimes.add(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count());
+}
+
+BaseLib::PVariable KodiPersistence::getMetrics()
+{
+	BaseLib::PVariable metrics = std::make_shared<BaseLib::Variable>(BaseLib::VariableType::tStruct);
+	try
+	{
+		size_t pending = 0;
+		{
+			std::lock_guard<std::mutex> entriesGuard(_entriesMutex);
+			pending = _entries.size();
+		}
+		uint64_t updates = _updates;
+		uint64_t writes = _writes;
+		metrics->structValue->emplace("updates", std::make_shared<BaseLib::Variable>((int64_t)updates));
+		metrics->structValue->emplace("writes", std::make_shared<BaseLib::Variable>((int64_t)writes));
+		metrics->structValue->emplace("flushes", std::make_shared<BaseLib::Variable>((int64_t)_flushes.load()));
+		metrics->structValue->emplace("pendingWrites", std::make_shared<BaseLib::Variable>((int64_t)pending));
+		metrics->structValue->emplace("writeAmplificationPercent", std::make_shared<BaseLib::Variable>((int64_t)(updates == 0 ? 0 : (writes * 100) / updates)));
+		metrics->structValue->emplace("flushTimes", _flushTimes.toVariable());
+	}
+	catch(const std::exception& ex)
+	{
+		GD::out.printEx(__FILE__, __LINE__, __PRETTY_FUNCTION__, ex.what());
+	}
+	return metrics;
+}
+
+}
@@ -0,0 +1,128 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODIPERSISTENCE_H_
+#define KODIPERSISTENCE_H_
+
+#include <homegear-base/BaseLib.h>
+#include "KodiHistogram.h"
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace Kodi
+{
+
+/**
+ * Module wide write-behind cache for peer variables. Values are collected per peer, channel and parameter and written to the
+ * database in intervals, so a parameter changing several times within one interval is written only once. Writing happens on the
+ * event loop instead of the thread processing notifications.
+ */
+class KodiPersistence
+{
+public:
+	/**
+	 * Writes "data" to the database. Called on the flushing thread.
+	 */
+	typedef std::function<void(std::vector<uint8_t>& data)> WriteCallback;
+
+	KodiPersistence() = default;
+	virtual ~KodiPersistence();
+
+	/**
+	 * Starts flushing every "interval" milliseconds. With an interval of "0" or less values are written immediately.
+	 */
+	void start(int64_t interval);
+
+	/**
+	 * Stops the interval and writes all pending values.
+	 */
+	void stop();
+
+	/**
+	 * Queues "data" for writing. A pending value of the same parameter is replaced.
+	 */
+	void save(uint64_t peerId, uint32_t channel, const std::string& name, const std::vector<uint8_t>& data, WriteCallback writeCallback);
+
+	/**
+	 * Writes all pending values.
+	 */
+	void flush();
+
+	/**
+	 * Writes the pending values of one peer. Called when the peer is disposed.
+	 */
+	void flush(uint64_t peerId);
+
+	/**
+	 * Drops the pending values of a peer without writing them. Used when the peer is deleted.
+	 */
+	void discard(uint64_t peerId);
+
+	/**
+	 * @return Returns a struct with the number of saved values ("updates"), database writes ("writes"), flushes, pending values,
+	 * the writes per 100 updates ("writeAmplificationPercent") and a histogram of the flush durations in microseconds.
+	 */
+	BaseLib::PVariable getMetrics();
+private:
+	typedef std::tuple<uint64_t, uint32_t, std::string> Key;
+
+	struct Entry
+	{
+		std::vector<uint8_t> data;
+		WriteCallback writeCallback;
+	};
+
+	std::mutex _entriesMutex;
+	std::map<Key, Entry> _entries;
+
+	//Held while writing, so an older value can't be written after a newer one.
+	std::mutex _writeMutex;
+
+	std::atomic<int64_t> _interval{0};
+	std::atomic<uint64_t> _timerId{0};
+	std::atomic_bool _stopped{true};
+
+	std::atomic<uint64_t> _updates{0};
+	std::atomic<uint64_t> _writes{0};
+	std::atomic<uint64_t> _flushes{0};
+	KodiHistogram _flushTimes;
+
+	void scheduleFlush();
+	void write(std::map<Key, Entry>& entries);
+};
+
+}
+
+#endif
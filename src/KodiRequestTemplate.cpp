@@ -0,0 +1,195 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiRequestTemplate.h"
+
+#include <charconv>
+#include <cmath>
+
+namespace Kodi
+{
+
+KodiRequestTemplate::KodiRequestTemplate(const BaseLib::DeviceDescription::PPacket& packet)
+{
+	_prefix = "{\"jsonrpc\":\"2.0\",\"method\":";
+	appendString(_prefix, packet->function1);
+	_prefix.append(",\"params\":[");
+	_size += _prefix.size();
+
+	//The separators between variable parameters are added when the request is built, because unknown parameters are omitted.
+	std::string literal;
+	for(auto& payload : packet->jsonPayloads)
+	{
+		size_t literalSize = literal.size();
+		if(!literal.empty()) literal.push_back(',');
+		if(payload->constValueIntegerSet) literal.append(std::to_string(payload->constValueInteger));
+		else if(payload->constValueBooleanSet) literal.append(payload->constValueBoolean ? "true" : "false");
+		else if(payload->constValueDecimalSet) appendValue(literal, std::make_shared<BaseLib::Variable>(payload->constValueDecimal));
+		else if(payload->constValueStringSet) appendString(literal, payload->constValueString);
+		else
+		{
+			literal.resize(literalSize);
+			if(!literal.empty())
+			{
+				_size += literal.size();
+				_elements.push_back(Element{std::move(literal), ""});
+				literal.clear();
+			}
+			_elements.push_back(Element{"", payload->parameterId});
+		}
+	}
+	if(!literal.empty())
+	{
+		_size += literal.size();
+		_elements.push_back(Element{std::move(literal), ""});
+	}
+
+	_suffix = "],\"id\":";
+	_size += _suffix.size();
+}
+
+void KodiRequestTemplate::append(std::string& json, const std::function<bool(const std::string& parameterId, std::string& json)>& appendParameter) const
+{
+	json.append(_prefix);
+	bool first = true;
+	for(auto& element : _elements)
+	{
+		size_t size = json.size();
+		if(!first) json.push_back(',');
+		if(element.parameterId.empty()) json.append(element.literal);
+		else if(!appendParameter(element.parameterId, json))
+		{
+			json.resize(size);
+			continue;
+		}
+		first = false;
+	}
+	json.append(_suffix);
+}
+
+void KodiRequestTemplate::appendString(std::string& json, const std::string& value)
+{
+	static const char hex[] = "0123456789abcdef";
+	json.push_back('"');
+	for(char c : value)
+	{
+		switch(c)
+		{
+		case '"': json.append("\\\""); break;
+		case '\\': json.append("\\\\"); break;
+		case '\b': json.append("\\b"); break;
+		case '\f': json.append("\\f"); break;
+		case '\n': json.append("\\n"); break;
+		case '\r': json.append("\\r"); break;
+		case '\t': json.append("\\t"); break;
+		default:
+			if((uint8_t)c < 0x20)
+			{
+				json.append("\\u00");
+				json.push_back(hex[(uint8_t)c >> 4]);
+				json.push_back(hex[(uint8_t)c & 0x0F]);
+			}
+			else json.push_back(c);
+		}
+	}
+	json.push_back('"');
+}
+
+void KodiRequestTemplate::appendValue(std::string& json, const BaseLib::PVariable& value)
+{
+	if(!value)
+	{
+		json.append("null");
+		return;
+	}
+
+	char buffer[32];
+	switch(value->type)
+	{
+	case BaseLib::VariableType::tBoolean:
+		json.append(value->booleanValue ? "true" : "false");
+		break;
+	case BaseLib::VariableType::tInteger:
+	{
+		auto result = std::to_chars(buffer, buffer + sizeof(buffer), value->integerValue);
+		json.append(buffer, result.ptr - buffer);
+		break;
+	}
+	case BaseLib::VariableType::tInteger64:
+	{
+		auto result = std::to_chars(buffer, buffer + sizeof(buffer), value->integerValue64);
+		json.append(buffer, result.ptr - buffer);
+		break;
+	}
+	case BaseLib::VariableType::tFloat:
+	{
+		if(!std::isfinite(value->floatValue))
+		{
+			json.append("null");
+			break;
+		}
+		auto result = std::to_chars(buffer, buffer + sizeof(buffer), value->floatValue);
+		json.append(buffer, result.ptr - buffer);
+		break;
+	}
+	case BaseLib::VariableType::tString:
+	case BaseLib::VariableType::tBase64:
+		appendString(json, value->stringValue);
+		break;
+	case BaseLib::VariableType::tArray:
+	{
+		json.push_back('[');
+		for(auto i = value->arrayValue->begin(); i != value->arrayValue->end(); ++i)
+		{
+			if(i != value->arrayValue->begin()) json.push_back(',');
+			appendValue(json, *i);
+		}
+		json.push_back(']');
+		break;
+	}
+	case BaseLib::VariableType::tStruct:
+	{
+		json.push_back('{');
+		for(auto i = value->structValue->begin(); i != value->structValue->end(); ++i)
+		{
+			if(i != value->structValue->begin()) json.push_back(',');
+			appendString(json, i->first);
+			json.push_back(':');
+			appendValue(json, i->second);
+		}
+		json.push_back('}');
+		break;
+	}
+	default:
+		json.append("null");
+		break;
+	}
+}
+
+}
@@ -0,0 +1,93 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODIREQUESTTEMPLATE_H_
+#define KODIREQUESTTEMPLATE_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace Kodi
+{
+
+/**
+ * Pre-serialized JSON-RPC request for a packet from the device description file. The method and all constant parameters are
+ * encoded once when the device description is loaded. Sending a command only appends the variable parameters and the id.
+ */
+class KodiRequestTemplate
+{
+public:
+	struct Element
+	{
+		/**
+		 * Encoded JSON of one or more consecutive constant parameters. Empty for variable parameters.
+		 */
+		std::string literal;
+
+		/**
+		 * The variable parameter. Empty for constants.
+		 */
+		std::string parameterId;
+	};
+
+	KodiRequestTemplate() = default;
+	explicit KodiRequestTemplate(const BaseLib::DeviceDescription::PPacket& packet);
+	virtual ~KodiRequestTemplate() = default;
+
+	/**
+	 * Appends the request to "json". The request ends with "\"id\":", so it is completed by appending the id and "}".
+	 *
+	 * @param appendParameter Appends the value of a variable parameter to "json". Returns false when the parameter is unknown. Unknown
+	 * parameters are omitted from the request.
+	 */
+	void append(std::string& json, const std::function<bool(const std::string& parameterId, std::string& json)>& appendParameter) const;
+
+	/**
+	 * @return Returns the size of all literals, which is the minimum size of the request.
+	 */
+	size_t size() const { return _size; }
+
+	/**
+	 * Appends "value" to "json" in JSON notation. Infinite and NaN floats are not valid JSON and are encoded as null.
+	 */
+	static void appendValue(std::string& json, const BaseLib::PVariable& value);
+	static void appendString(std::string& json, const std::string& value);
+private:
+	std::string _prefix;
+	std::vector<Element> _elements;
+	std::string _suffix;
+	size_t _size = 0;
+};
+
+}
+
+#endif
@@ -0,0 +1,120 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODISPSCQUEUE_H_
+#define KODISPSCQUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Kodi
+{
+
+/**
+ * Bounded lock-free queue for exactly one producer and one consumer thread. The capacity is rounded up to a power of two. Producer
+ * and consumer only share the two positions, which are kept on separate cache lines.
+ *
+ * "Thread" means one logical thread: Successive producers or consumers on different threads are fine, as long as each handoff
+ * between them synchronizes (e. g. through a mutex or an atomic flag).
+ */
+template<typename T>
+class KodiSpscQueue
+{
+public:
+	explicit KodiSpscQueue(size_t capacity)
+	{
+		size_t size = 2;
+		while(size < capacity) size <<= 1;
+		_slots.resize(size);
+		_mask = size - 1;
+	}
+	virtual ~KodiSpscQueue() = default;
+
+	KodiSpscQueue(const KodiSpscQueue&) = delete;
+	KodiSpscQueue& operator=(const KodiSpscQueue&) = delete;
+
+	/**
+	 * Only called by the producer.
+	 *
+	 * @return Returns false when the queue is full. "item" is not moved from in that case.
+	 */
+	bool push(T&& item)
+	{
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		if(tail - _cachedHead == _slots.size())
+		{
+			_cachedHead = _head.load(std::memory_order_acquire);
+			if(tail - _cachedHead == _slots.size()) return false;
+		}
+		_slots[tail & _mask] = std::move(item);
+		_tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Only called by the consumer.
+	 *
+	 * @return Returns false when the queue is empty.
+	 */
+	bool pop(T& item)
+	{
+		size_t head = _head.load(std::memory_order_relaxed);
+		if(head == _cachedTail)
+		{
+			_cachedTail = _tail.load(std::memory_order_acquire);
+			if(head == _cachedTail) return false;
+		}
+		item = std::move(_slots[head & _mask]);
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Can be called from any thread. The result might be outdated immediately.
+	 */
+	bool empty() const { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire); }
+	size_t capacity() const { return _slots.size(); }
+private:
+	std::vector<T> _slots;
+	size_t _mask = 0;
+
+	//Written by the consumer
+	alignas(64) std::atomic<size_t> _head{0};
+	size_t _cachedTail = 0;
+
+	//Written by the producer
+	alignas(64) std::atomic<size_t> _tail{0};
+	size_t _cachedHead = 0;
+};
+
+}
+
+#endif
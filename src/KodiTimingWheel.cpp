@@ -0,0 +1,155 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiTimingWheel.h"
+
+#include <algorithm>
+
+namespace Kodi
+{
+
+KodiTimingWheel::KodiTimingWheel(uint32_t slotCount, int64_t tickDuration, int64_t startTime)
+{
+	uint32_t size = 1;
+	while(size < slotCount && size < 0x80000000) size <<= 1;
+	_slots.resize(size, npos);
+	_mask = size - 1;
+	_tickDuration = tickDuration < 1 ? 1 : tickDuration;
+	_startTime = startTime;
+}
+
+uint64_t KodiTimingWheel::add(int64_t delay, std::function<void()> callback, int64_t time)
+{
+	uint32_t index = _freeEntries;
+	if(index != npos) _freeEntries = _entries[index].next;
+	else
+	{
+		index = _entries.size();
+		_entries.emplace_back();
+	}
+
+	//The id combines the index with a generation counter, so ids of released entries never match again.
+	_generation++;
+	if(_generation == 0) _generation = 1;
+	Entry& entry = _entries[index];
+	entry.id = ((uint64_t)_generation << 32) | index;
+	entry.callback = std::move(callback);
+
+	//Round up, a timeout must never expire early.
+	int64_t deadlineTime = time + (delay < 0 ? 0 : delay) - _startTime;
+	uint64_t deadline = deadlineTime <= 0 ? 0 : (uint64_t)((deadlineTime + _tickDuration - 1) / _tickDuration);
+	if(deadline <= _currentTick) deadline = _currentTick + 1;
+	entry.deadline = deadline;
+	entry.slot = deadline & _mask;
+
+	entry.previous = npos;
+	entry.next = _slots[entry.slot];
+	if(entry.next != npos) _entries[entry.next].previous = index;
+	_slots[entry.slot] = index;
+	_size++;
+	return entry.id;
+}
+
+void KodiTimingWheel::unlink(uint32_t index)
+{
+	Entry& entry = _entries[index];
+	if(entry.previous != npos) _entries[entry.previous].next = entry.next;
+	else _slots[entry.slot] = entry.next;
+	if(entry.next != npos) _entries[entry.next].previous = entry.previous;
+	_size--;
+}
+
+void KodiTimingWheel::release(uint32_t index)
+{
+	Entry& entry = _entries[index];
+	entry.id = 0;
+	entry.slot = npos;
+	entry.previous = npos;
+	entry.callback = std::function<void()>();
+	entry.next = _freeEntries;
+	_freeEntries = index;
+}
+
+bool KodiTimingWheel::remove(uint64_t id)
+{
+	uint32_t index = id & 0xFFFFFFFF;
+	if(id == 0 || index >= _entries.size() || _entries[index].id != id) return false;
+	unlink(index);
+	release(index);
+	return true;
+}
+
+void KodiTimingWheel::advance(int64_t time, std::vector<std::function<void()>>& expired)
+{
+	if(time < _startTime) return;
+	uint64_t targetTick = (uint64_t)((time - _startTime) / _tickDuration);
+	if(_size == 0)
+	{
+		if(targetTick > _currentTick) _currentTick = targetTick;
+		return;
+	}
+
+	while(_currentTick < targetTick)
+	{
+		_currentTick++;
+		uint32_t index = _slots[_currentTick & _mask];
+		while(index != npos)
+		{
+			uint32_t next = _entries[index].next;
+			if(_entries[index].deadline <= _currentTick)
+			{
+				expired.emplace_back(std::move(_entries[index].callback));
+				unlink(index);
+				release(index);
+			}
+			index = next;
+		}
+		if(_size == 0)
+		{
+			_currentTick = targetTick;
+			break;
+		}
+	}
+}
+
+int64_t KodiTimingWheel::nextTick() const
+{
+	if(_size == 0) return -1;
+	return _startTime + (int64_t)(_currentTick + 1) * _tickDuration;
+}
+
+void KodiTimingWheel::clear()
+{
+	std::fill(_slots.begin(), _slots.end(), npos);
+	_entries.clear();
+	_freeEntries = npos;
+	_size = 0;
+}
+
+}
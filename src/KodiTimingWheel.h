@@ -0,0 +1,112 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODITIMINGWHEEL_H_
+#define KODITIMINGWHEEL_H_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace Kodi
+{
+
+/**
+ * Hashed timing wheel for timeouts, which are usually removed long before they expire. Adding and removing a timeout are O(1)
+ * and don't allocate once the entry pool has grown to the number of concurrently pending timeouts. Timeouts expire with the
+ * resolution of one tick. Timeouts longer than one revolution stay in their slot for the required number of rounds.
+ *
+ * The class is not thread safe.
+ */
+class KodiTimingWheel
+{
+public:
+	/**
+	 * @param slotCount The number of slots. Rounded up to a power of two.
+	 * @param tickDuration The resolution in milliseconds.
+	 * @param startTime The current time in milliseconds.
+	 */
+	KodiTimingWheel(uint32_t slotCount, int64_t tickDuration, int64_t startTime);
+	virtual ~KodiTimingWheel() = default;
+
+	/**
+	 * @return Returns the id needed to remove the timeout. The id is never 0.
+	 */
+	uint64_t add(int64_t delay, std::function<void()> callback, int64_t time);
+
+	/**
+	 * @return Returns false when the timeout doesn't exist (anymore).
+	 */
+	bool remove(uint64_t id);
+
+	/**
+	 * Moves the wheel forward to "time" and appends the callbacks of all expired timeouts to "expired".
+	 */
+	void advance(int64_t time, std::vector<std::function<void()>>& expired);
+
+	/**
+	 * @return Returns the time of the next tick or -1 when no timeout is pending.
+	 */
+	int64_t nextTick() const;
+
+	void clear();
+	size_t size() const { return _size; }
+	int64_t tickDuration() const { return _tickDuration; }
+private:
+	static constexpr uint32_t npos = 0xFFFFFFFF;
+
+	struct Entry
+	{
+		uint64_t id = 0;
+		uint64_t deadline = 0;
+		uint32_t previous = npos;
+		uint32_t next = npos;
+		uint32_t slot = npos;
+		std::function<void()> callback;
+	};
+
+	int64_t _tickDuration = 100;
+	int64_t _startTime = 0;
+	uint64_t _currentTick = 0;
+	uint32_t _mask = 0;
+	size_t _size = 0;
+
+	//Each slot is a doubly linked list of indexes into _entries. Free entries are linked through "next".
+	std::vector<uint32_t> _slots;
+	std::vector<Entry> _entries;
+	uint32_t _freeEntries = npos;
+	uint32_t _generation = 0;
+
+	void unlink(uint32_t index);
+	void release(uint32_t index);
+};
+
+}
+
+#endif
@@ -0,0 +1,104 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#include "KodiValueConverter.h"
+
+namespace Kodi
+{
+
+using namespace BaseLib::DeviceDescription;
+
+KodiValueConverter::KodiValueConverter(const PParameter& parameter) : _parameter(parameter)
+{
+	if(!parameter || !parameter->logical || !parameter->physical) return;
+	if(parameter->physical->type != IPhysical::Type::Enum::none) return;
+	if(parameter->casts.size() != 1 || !std::dynamic_pointer_cast<ParameterCast::RpcBinary>(parameter->casts.front())) return;
+
+	switch(parameter->logical->type)
+	{
+	case ILogical::Type::Enum::tBoolean:
+		_directType = BaseLib::VariableType::tBoolean;
+		break;
+	case ILogical::Type::Enum::tInteger:
+	{
+		std::shared_ptr<LogicalInteger> logical = std::dynamic_pointer_cast<LogicalInteger>(parameter->logical);
+		if(!logical) return;
+		_directType = BaseLib::VariableType::tInteger;
+		_checkRange = true;
+		_minimumValue = logical->minimumValue;
+		_maximumValue = logical->maximumValue;
+		break;
+	}
+	case ILogical::Type::Enum::tEnum:
+	{
+		std::shared_ptr<LogicalEnumeration> logical = std::dynamic_pointer_cast<LogicalEnumeration>(parameter->logical);
+		if(!logical) return;
+		_directType = BaseLib::VariableType::tInteger;
+		_checkRange = true;
+		_minimumValue = logical->minimumValue;
+		_maximumValue = logical->maximumValue;
+		break;
+	}
+	case ILogical::Type::Enum::tString:
+		_directType = BaseLib::VariableType::tString;
+		break;
+	case ILogical::Type::Enum::tStruct:
+		_directType = BaseLib::VariableType::tStruct;
+		break;
+	case ILogical::Type::Enum::tArray:
+		_directType = BaseLib::VariableType::tArray;
+		break;
+	default:
+		//Actions and decimals are adjusted by the parameter.
+		break;
+	}
+}
+
+void KodiValueConverter::convert(const BaseLib::PVariable& value, BaseLib::Rpc::RpcEncoder& encoder, std::vector<uint8_t>& data) const
+{
+	if(!value) return;
+	if(!isDirect() || value->type != _directType || (_checkRange && (value->integerValue < _minimumValue || value->integerValue > _maximumValue)))
+	{
+		convertGeneric(value, encoder, data);
+		return;
+	}
+	data.clear();
+	encoder.encodeResponse(value, data);
+}
+
+void KodiValueConverter::convertGeneric(const BaseLib::PVariable& value, BaseLib::Rpc::RpcEncoder& encoder, std::vector<uint8_t>& data) const
+{
+	if(!value || !_parameter) return;
+	std::vector<uint8_t> encodedData;
+	encoder.encodeResponse(value, encodedData);
+	BaseLib::PVariable logicalValue = _parameter->convertFromPacket(encodedData, BaseLib::Role(), true);
+	_parameter->convertToPacket(logicalValue, BaseLib::Role(), data);
+}
+
+}
@@ -0,0 +1,86 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODIVALUECONVERTER_H_
+#define KODIVALUECONVERTER_H_
+
+#include <homegear-base/BaseLib.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Kodi
+{
+
+/**
+ * Converts values from notifications to the binary form stored for a parameter. The conversion is resolved once from the
+ * parameter's casts and types. Parameters with only the "rpcBinary" cast and no physical encoding store the binary RPC encoding
+ * of their logical value, so values which already have the logical type are encoded directly. All other values take the generic
+ * path through convertFromPacket() and convertToPacket().
+ */
+class KodiValueConverter
+{
+public:
+	KodiValueConverter() = default;
+	explicit KodiValueConverter(const BaseLib::DeviceDescription::PParameter& parameter);
+	virtual ~KodiValueConverter() = default;
+
+	/**
+	 * @return Returns true when values can be converted without the generic path.
+	 */
+	bool isDirect() const { return _directType != BaseLib::VariableType::tVoid; }
+
+	/**
+	 * Converts "value" to the binary form of the parameter.
+	 *
+	 * @param[out] data The converted value.
+	 */
+	void convert(const BaseLib::PVariable& value, BaseLib::Rpc::RpcEncoder& encoder, std::vector<uint8_t>& data) const;
+
+	/**
+	 * Same as convert(), but always uses the generic path. Used for benchmarks.
+	 */
+	void convertGeneric(const BaseLib::PVariable& value, BaseLib::Rpc::RpcEncoder& encoder, std::vector<uint8_t>& data) const;
+private:
+	BaseLib::DeviceDescription::PParameter _parameter;
+
+	/**
+	 * The type values need to have for the direct conversion or "tVoid" if only the generic path can be used.
+	 */
+	BaseLib::VariableType _directType = BaseLib::VariableType::tVoid;
+
+	//Integers outside of this range are passed to the generic path, which limits them.
+	bool _checkRange = false;
+	int64_t _minimumValue = 0;
+	int64_t _maximumValue = 0;
+};
+
+}
+
+#endif
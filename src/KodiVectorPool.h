@@ -0,0 +1,82 @@
+/* Copyright 2013-2019 Homegear GmbH
+ *
+ * Homegear is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Homegear is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Homegear.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of portions of this program with the
+ * OpenSSL library under certain conditions as described in each
+ * individual source file, and distribute linked combinations
+ * including the two.
+ * You must obey the GNU General Public License in all respects
+ * for all of the code used other than OpenSSL.  If you modify
+ * file(s) with this exception, you may extend this exception to your
+ * version of the file(s), but you are not obligated to do so.  If you
+ * do not wish to do so, delete this exception statement from your
+ * version.  If you delete this exception statement from all source
+ * files in the program, then also delete it here.
+ */
+
+#ifndef KODIVECTORPOOL_H_
+#define KODIVECTORPOOL_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Kodi
+{
+
+/**
+ * Pool of shared vectors for event values. Events hand their vectors to other modules, which might keep them for a while, so a
+ * vector is only reused when the pool holds the last reference to it. Reused vectors keep their capacity.
+ */
+template<typename T>
+class KodiVectorPool
+{
+public:
+	/**
+	 * @param maxSize The maximum number of vectors kept. When all of them are in use, new vectors are not pooled.
+	 */
+	explicit KodiVectorPool(size_t maxSize = 8) : _maxSize(maxSize) {}
+	virtual ~KodiVectorPool() = default;
+
+	/**
+	 * @return Returns an empty vector.
+	 */
+	std::shared_ptr<std::vector<T>> get()
+	{
+		std::lock_guard<std::mutex> vectorsGuard(_vectorsMutex);
+		for(auto& vector : _vectors)
+		{
+			if(vector.use_count() != 1) continue;
+			//Synchronizes with the release of the last other reference.
+			std::atomic_thread_fence(std::memory_order_acquire);
+			vector->clear();
+			return vector;
+		}
+		auto vector = std::make_shared<std::vector<T>>();
+		if(_vectors.size() < _maxSize) _vectors.push_back(vector);
+		return vector;
+	}
+private:
+	std::mutex _vectorsMutex;
+	std::vector<std::shared_ptr<std::vector<T>>> _vectors;
+	size_t _maxSize = 8;
+};
+
+}
+
+#endif